@@ -0,0 +1,71 @@
+#!/bin/sh
+# Check the allocations per record of each command in steady state.
+#
+# usage: alloc-check.sh <rgsam-alloc> <corpus dir>
+#
+# Each case runs on the illumina-1.8 corpus file and on its first half, and
+# the difference in allocations between the two runs, divided by the
+# difference in records, is compared against the budget of the case. This
+# excludes the fixed allocations of start-up, headers and output files.
+
+rgsam=$(cd "$(dirname "$1")" && pwd)/$(basename "$1")
+corpus=$2
+dir=$corpus/alloc
+
+mkdir -p "$dir" || exit 1
+
+# first half of the inputs, keeping the SAM header and whole FASTQ entries
+sam=$corpus/illumina-1.8.sam
+fq=$corpus/illumina-1.8.fq
+n=$(grep -vc '^@' "$sam")
+{ grep '^@' "$sam"; grep -v '^@' "$sam" | head -n $((n / 2)); } > "$dir/half.sam"
+head -n $(($(wc -l < "$fq") / 8 * 4)) "$fq" > "$dir/half.fq"
+cp "$sam" "$dir/full.sam"
+cp "$fq" "$dir/full.fq"
+
+# print "<allocations> <records>" of one run from its --stats output
+measure() {
+	sed -n \
+		-e 's/^Stats: records \([0-9]*\),.*/records \1/p' \
+		-e 's/^Stats: allocations \([0-9]*\) .*/allocations \1/p' |
+	awk '{ x[$1] = $2 } END { print x["allocations"], x["records"] }'
+}
+
+# run one case on both inputs: <name> <budget> <input ext> <via pipe?> <args...>
+failures=0
+check() {
+	name=$1; budget=$2; ext=$3; pipe=$4
+	shift 4
+	for size in half full; do
+		in=$size.$ext
+		if [ "$pipe" = pipe ]; then
+			out=$(cd "$dir" && cat "$in" | "$rgsam" "$@" --stats 2>&1 >/dev/null | measure)
+		else
+			out=$(cd "$dir" && "$rgsam" "$@" -i "$in" --stats 2>&1 >/dev/null | measure)
+		fi
+		eval "$size=\"$out\""
+	done
+	echo "$half $full" | awk -v name="$name" -v budget="$budget" '{
+		a = $3 - $1; r = $4 - $2
+		if (r <= 0) { printf "%-16s no records\n", name; exit 1 }
+		x = a / r
+		printf "%-16s %8.4f allocations per record (budget %s)\n", name, x, budget
+		exit x > budget
+	}' || failures=$((failures + 1))
+}
+
+check collect-sam 0.01 sam file collect -f sam -s s -o /dev/null
+check collect-sam-x 0.01 sam file collect -f sam -s s -o /dev/null -x index.rgi
+check split-sam 0.01 sam file split -f sam -s s -o /dev/null
+check split-tag-sam 0.01 sam file split -t -f sam -s s -o /dev/null
+check tag 0.01 sam file tag -s s -o /dev/null
+check tag-spool 0.01 sam pipe tag -s s -o /dev/null
+check collect-fq 0.01 fq file collect -f fastq -s s -o /dev/null
+check split-fq 0.01 fq file split -f fastq -s s -o /dev/null
+
+rm -rf "$dir"
+
+if [ $failures -gt 0 ]; then
+	echo "$failures case(s) over allocation budget"
+	exit 1
+fi
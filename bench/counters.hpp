@@ -0,0 +1,106 @@
+#ifndef _RGSAM_BENCH_COUNTERS_HPP_
+#define _RGSAM_BENCH_COUNTERS_HPP_
+
+#include <cstring>
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+/**
+ * Hardware performance counters of the calling thread, read with
+ * perf_event_open(2).
+ *
+ * Each counter is opened on its own, so that a counter the machine or the
+ * container does not permit (see /proc/sys/kernel/perf_event_paranoid) is
+ * left unavailable without affecting the others. Counts are scaled up if the
+ * kernel multiplexed the counters.
+ */
+class hw_counters {
+public:
+    enum event {
+        CYCLES,
+        INSTRUCTIONS,
+        CACHE_MISSES,
+        BRANCH_MISSES,
+        n_events
+    };
+
+    hw_counters() {
+        const unsigned long long configs[n_events] = {
+            PERF_COUNT_HW_CPU_CYCLES,
+            PERF_COUNT_HW_INSTRUCTIONS,
+            PERF_COUNT_HW_CACHE_MISSES,
+            PERF_COUNT_HW_BRANCH_MISSES
+        };
+        for (int i = 0; i < n_events; ++i) {
+            struct perf_event_attr attr;
+            memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = configs[i];
+            attr.disabled = 1;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+            fds[i] = syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+            counts[i] = 0;
+        }
+    }
+
+    ~hw_counters() {
+        for (int i = 0; i < n_events; ++i) {
+            if (fds[i] >= 0) close(fds[i]);
+        }
+    }
+
+    /**
+     * Whether any counter could be opened.
+     */
+    bool good() const {
+        for (int i = 0; i < n_events; ++i) {
+            if (fds[i] >= 0) return true;
+        }
+        return false;
+    }
+
+    bool available(event e) const {
+        return fds[e] >= 0;
+    }
+
+    void start() {
+        for (int i = 0; i < n_events; ++i) {
+            if (fds[i] < 0) continue;
+            ioctl(fds[i], PERF_EVENT_IOC_RESET, 0);
+            ioctl(fds[i], PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+
+    void stop() {
+        for (int i = 0; i < n_events; ++i) {
+            if (fds[i] < 0) continue;
+            ioctl(fds[i], PERF_EVENT_IOC_DISABLE, 0);
+            // value, time enabled, time running
+            unsigned long long x[3];
+            if (read(fds[i], x, sizeof(x)) != sizeof(x) || x[2] == 0) {
+                counts[i] = 0;
+            } else {
+                counts[i] = x[2] < x[1] ? (unsigned long long) ((double) x[0] * x[1] / x[2]) : x[0];
+            }
+        }
+    }
+
+    /**
+     * Count of an event between the last `start` and `stop`.
+     */
+    unsigned long long operator[](event e) const {
+        return counts[e];
+    }
+
+private:
+    int fds[n_events];
+    unsigned long long counts[n_events];
+};
+
+#endif  // _RGSAM_BENCH_COUNTERS_HPP_
@@ -0,0 +1,236 @@
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <cstring>
+#include <cstdio>
+#include <cstdlib>
+
+#include <time.h>
+#include <sys/types.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "../rgsam/file.hpp"
+
+using namespace std;
+
+/**
+ * End-to-end throughput benchmark of rgsam commands.
+ *
+ * Each case runs the rgsam binary as a child process on a generated input
+ * (passed on stdin, with the working directory set to the output directory),
+ * and records its wall time and peak resident set size, keeping the best of
+ * several repetitions. Results are written to a results file and, if a
+ * baseline file is given, compared against it: any case that is slower or
+ * larger than the baseline by more than the threshold fraction is reported
+ * as a regression.
+ */
+
+struct result {
+    double seconds;
+    double mb_per_s;
+    double records_per_s;
+    long maxrss_kb;
+
+    result() : seconds(0), mb_per_s(0), records_per_s(0), maxrss_kb(0) {}
+};
+
+struct bench_case {
+    const char* name;
+    const char* input;
+    const char* args;
+};
+
+/**
+ * Cases in order of execution; `tag-rg` uses the output of `collect-sam`.
+ */
+const bench_case cases[] = {
+    { "collect-sam", "illumina-1.8.sam", "collect -f sam -s s -o rg.txt" },
+    { "split-sam", "illumina-1.8.sam", "split -f sam -s s -o /dev/null" },
+    { "split-tag-sam", "illumina-1.8.sam", "split -t -f sam -s t -o /dev/null" },
+    { "tag-rg", "illumina-1.8.sam", "tag -r rg.txt -o /dev/null" },
+    { "tag", "illumina-1.8.sam", "tag -s s -o /dev/null" },
+    { "collect-fq", "illumina-1.8.fq", "collect -f fastq -s s -o /dev/null" },
+    { "split-fq", "illumina-1.8.fq", "split -f fastq -s s -o /dev/null" },
+    { NULL, NULL, NULL }
+};
+
+double now_s() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/**
+ * Count the records in a SAM or FASTQ file.
+ */
+unsigned long long count_records(const string& fname, unsigned long long& bytes) {
+    mapped_file f(fname.c_str());
+    if (!f.good()) return 0;
+    bytes = f.size;
+
+    bool fastq = fname.rfind(".fq") == fname.length() - 3;
+    unsigned long long lines = 0;
+    const char* p = f.data;
+    const char* end = p + f.size;
+    while (p < end) {
+        const char* eol = static_cast<const char*>(memchr(p, '\n', end - p));
+        if (eol == NULL) eol = end;
+        if (fastq || *p != '@') ++lines;
+        p = eol + 1;
+    }
+    return fastq ? lines / 4 : lines;
+}
+
+/**
+ * Run rgsam in a child process and measure it.
+ */
+bool run(const string& rgsam, const string& input, const string& args, const string& dir, double& seconds, long& maxrss_kb) {
+    vector<string> tokens;
+    tokens.push_back(rgsam);
+    istringstream ss(args);
+    string token;
+    while (ss >> token) tokens.push_back(token);
+
+    vector<char*> argv;
+    for (size_t i = 0; i < tokens.size(); ++i) {
+        argv.push_back(const_cast<char*>(tokens[i].c_str()));
+    }
+    argv.push_back(NULL);
+
+    double start = now_s();
+    pid_t pid = fork();
+    if (pid < 0) return false;
+    if (pid == 0) {
+        int in_fd = open(input.c_str(), O_RDONLY);
+        int null_fd = open("/dev/null", O_WRONLY);
+        if (in_fd < 0 || null_fd < 0 || chdir(dir.c_str()) != 0) _exit(127);
+        dup2(in_fd, 0);
+        dup2(null_fd, 2);
+        execv(argv[0], &argv[0]);
+        _exit(127);
+    }
+
+    int status;
+    struct rusage usage;
+    if (wait4(pid, &status, 0, &usage) < 0) return false;
+    seconds = now_s() - start;
+    maxrss_kb = usage.ru_maxrss;
+
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+bool read_results(const char* fname, map<string, result>& results) {
+    ifstream f(fname);
+    if (!f.good()) return false;
+    string line;
+    while (getline(f, line)) {
+        if (line.empty() || line[0] == '#') continue;
+        istringstream ss(line);
+        string name;
+        result r;
+        if (ss >> name >> r.seconds >> r.mb_per_s >> r.records_per_s >> r.maxrss_kb) {
+            results[name] = r;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 4) {
+        cerr << "usage: rgsam-e2e <rgsam> <input dir> <results file> [<repetitions> [<baseline file> [<threshold>]]]" << endl;
+        return 1;
+    }
+
+    string rgsam = argv[1];
+    string dir = argv[2];
+    const char* results_fname = argv[3];
+    int reps = argc > 4 ? atoi(argv[4]) : 1;
+    const char* baseline_fname = argc > 5 ? argv[5] : NULL;
+    double threshold = argc > 6 ? atof(argv[6]) : 0.1;
+
+    if (rgsam[0] != '/') {
+        char cwd[4096];
+        if (getcwd(cwd, sizeof(cwd)) == NULL) return 1;
+        rgsam = string(cwd) + "/" + rgsam;
+    }
+
+    string out_dir = dir + "/out";
+    mkdir(out_dir.c_str(), 0755);
+
+    map<string, result> results;
+    ofstream results_f(results_fname);
+    results_f << "#case\tseconds\tMB/s\trecords/s\tmaxrss_kb" << endl;
+    printf("%-16s %10s %10s %12s %12s\n", "case", "seconds", "MB/s", "records/s", "maxrss_kb");
+    for (const bench_case* c = cases; c->name != NULL; ++c) {
+        string input = dir + "/" + c->input;
+        unsigned long long bytes = 0;
+        unsigned long long records = count_records(input, bytes);
+        if (records == 0) {
+            cerr << "Error: input " << input << " is missing or empty" << endl;
+            return 1;
+        }
+
+        result r;
+        for (int i = 0; i < reps || i == 0; ++i) {
+            double seconds;
+            long maxrss_kb;
+            if (!run(rgsam, input, c->args, out_dir, seconds, maxrss_kb)) {
+                cerr << "Error: case " << c->name << " failed" << endl;
+                return 1;
+            }
+            if (i == 0 || seconds < r.seconds) r.seconds = seconds;
+            if (i == 0 || maxrss_kb < r.maxrss_kb) r.maxrss_kb = maxrss_kb;
+        }
+        r.mb_per_s = bytes / r.seconds / 1e6;
+        r.records_per_s = records / r.seconds;
+        results[c->name] = r;
+
+        printf("%-16s %10.3f %10.1f %12.0f %12ld\n", c->name, r.seconds, r.mb_per_s, r.records_per_s, r.maxrss_kb);
+        results_f << c->name << '\t' << r.seconds << '\t' << r.mb_per_s << '\t'
+                  << r.records_per_s << '\t' << r.maxrss_kb << endl;
+    }
+    results_f.close();
+
+    if (baseline_fname == NULL) return 0;
+
+    map<string, result> baseline;
+    if (!read_results(baseline_fname, baseline)) {
+        cerr << "Error: could not read baseline " << baseline_fname << endl;
+        return 1;
+    }
+
+    int regressions = 0;
+    for (map<string, result>::const_iterator it = results.begin(); it != results.end(); ++it) {
+        map<string, result>::const_iterator base = baseline.find(it->first);
+        if (base == baseline.end()) {
+            cerr << "Warning: case " << it->first << " is not in the baseline" << endl;
+            continue;
+        }
+        const result& x = it->second;
+        const result& b = base->second;
+        if (x.mb_per_s < b.mb_per_s * (1 - threshold)) {
+            cerr << "Regression: " << it->first << " throughput " << x.mb_per_s
+                 << " MB/s < baseline " << b.mb_per_s << " MB/s" << endl;
+            ++regressions;
+        }
+        if (x.maxrss_kb > b.maxrss_kb * (1 + threshold)) {
+            cerr << "Regression: " << it->first << " peak RSS " << x.maxrss_kb
+                 << " kB > baseline " << b.maxrss_kb << " kB" << endl;
+            ++regressions;
+        }
+    }
+
+    if (regressions > 0) {
+        cerr << regressions << " regression(s) beyond threshold " << threshold << endl;
+        return 1;
+    }
+    cerr << "No regressions beyond threshold " << threshold << endl;
+    return 0;
+}
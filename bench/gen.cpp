@@ -0,0 +1,256 @@
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <cstring>
+#include <cstdlib>
+#include <cstdio>
+
+#include "../rgsam/arg.hpp"
+
+using namespace std;
+
+/**
+ * Generate a synthetic SAM or FASTQ file for benchmarking.
+ *
+ * Output is fully determined by the options and the seed.
+ */
+
+/**
+ * Deterministic pseudo-random number generator (splitmix64).
+ */
+struct rng {
+    unsigned long long state;
+
+    rng(unsigned long long seed) : state(seed) {}
+
+    unsigned long long next() {
+        unsigned long long z = (state += 0x9e3779b97f4a7c15ULL);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        return z ^ (z >> 31);
+    }
+
+    /// uniform integer in [0, n)
+    unsigned long long below(unsigned long long n) {
+        return next() % n;
+    }
+};
+
+/**
+ * Interleaving pattern of read-groups along the file.
+ */
+enum pattern {
+    /// all reads of a read-group are contiguous
+    SORTED,
+    /// read-groups alternate read by read
+    ROUNDROBIN,
+    /// read-groups alternate in blocks of reads
+    BLOCKS,
+    /// each read draws its read-group at random
+    RANDOM
+};
+
+struct params {
+    const char* qnformat;
+    bool fastq;
+    unsigned long long n;
+    size_t min_length;
+    size_t max_length;
+    unsigned int groups;
+    unsigned int header;
+    pattern interleave;
+    unsigned long long block;
+};
+
+/**
+ * Read-group of the i-th read.
+ */
+unsigned int read_group_of(const params& p, unsigned long long i, rng& r) {
+    switch (p.interleave) {
+        case SORTED:
+            return (unsigned int) (i * p.groups / p.n);
+        case ROUNDROBIN:
+            return (unsigned int) (i % p.groups);
+        case BLOCKS:
+            return (unsigned int) ((i / p.block) % p.groups);
+        case RANDOM:
+        default:
+            return (unsigned int) r.below(p.groups);
+    }
+}
+
+/**
+ * Write read name of a read in read-group g, with 8 lanes per flowcell (or
+ * one movie per read-group, for PacBio).
+ */
+void make_qname(const params& p, unsigned int g, rng& r, string& qname) {
+    unsigned int flowcell = g / 8;
+    unsigned int lane = g % 8 + 1;
+    unsigned int tile = 1101 + (unsigned int) r.below(24);
+    unsigned int x = (unsigned int) r.below(30000);
+    unsigned int y = (unsigned int) r.below(200000);
+
+    char buf[128];
+    if (strcmp(p.qnformat, "illumina-1.0") == 0) {
+        snprintf(buf, sizeof(buf), "FC%03u-EAS100R:%u:%u:%u:%u#0/1",
+                flowcell, lane, tile, x, y);
+    } else if (strcmp(p.qnformat, "illumina-1.8") == 0) {
+        snprintf(buf, sizeof(buf), "EAS139:136:H%04uBBXX:%u:%u:%u:%u",
+                flowcell, lane, tile, x, y);
+    } else if (strcmp(p.qnformat, "broad-1.0") == 0) {
+        snprintf(buf, sizeof(buf), "H%04uALXX140820:%u:%u:%u:%u",
+                flowcell, lane, tile, x, y);
+    } else if (strcmp(p.qnformat, "mgi") == 0) {
+        snprintf(buf, sizeof(buf), "V30%07uL%uC%03uR%03u%07u/1",
+                flowcell, lane, tile % 1000, x % 1000, y);
+    } else if (strcmp(p.qnformat, "pacbio") == 0) {
+        snprintf(buf, sizeof(buf), "m64%03u_190830_220126/%u/ccs", g, y);
+    } else {
+        throw runtime_error("Unsupported read format");
+    }
+    qname = buf;
+}
+
+/**
+ * Fill sequence and quality strings of a random length.
+ */
+void make_read(const params& p, rng& r, string& seq, string& qual) {
+    static const char bases[] = "ACGT";
+    static const char quals[] = "FF:,";
+
+    size_t length = p.min_length;
+    if (p.max_length > p.min_length) {
+        length += r.below(p.max_length - p.min_length + 1);
+    }
+
+    seq.resize(length);
+    qual.resize(length);
+    unsigned long long bits = 0;
+    for (size_t i = 0; i < length; ++i) {
+        if (i % 16 == 0) bits = r.next();
+        seq[i] = bases[bits & 3];
+        qual[i] = quals[(bits >> 2) & 3];
+        bits >>= 4;
+    }
+}
+
+void write_sam_header(ostream& f, const params& p) {
+    f << "@HD\tVN:1.4\tSO:unsorted\n";
+    for (unsigned int i = 1; i <= p.header; ++i) {
+        f << "@SQ\tSN:chr" << i << "\tLN:" << (250000000 - i * 1000) << '\n';
+    }
+    f << "@PG\tID:rgsam-gen\tPN:rgsam-gen\n";
+}
+
+void generate(ostream& f, const params& p, unsigned long long seed) {
+    rng r(seed);
+    string qname, seq, qual;
+
+    if (!p.fastq) write_sam_header(f, p);
+
+    for (unsigned long long i = 0; i < p.n; ++i) {
+        unsigned int g = read_group_of(p, i, r);
+        make_qname(p, g, r, qname);
+        make_read(p, r, seq, qual);
+
+        if (p.fastq) {
+            f << '@' << qname;
+            if (strcmp(p.qnformat, "illumina-1.8") == 0) {
+                f << " 1:N:0:ACGTAC";
+            }
+            f << '\n' << seq << "\n+\n" << qual << '\n';
+        } else {
+            f << qname << '\t' << 0 << '\t'
+              << "chr" << (1 + r.below(p.header > 0 ? p.header : 1)) << '\t'
+              << (1 + r.below(100000000)) << '\t' << 60 << '\t'
+              << seq.length() << 'M' << "\t*\t0\t0\t"
+              << seq << '\t' << qual << '\t'
+              << "NM:i:0\tMD:Z:" << seq.length() << "\tAS:i:" << seq.length() << '\n';
+        }
+    }
+}
+
+int main(int argc, char* argv[]) {
+
+    argc -= (argc > 0); argv += (argc > 0);  // skip program name if present
+
+    enum optionIndex { UNKNOWN, HELP, OUTPUT, FORMAT, QNFORMAT, NREADS, LENGTH, GROUPS, HEADER, PATTERN, BLOCK, SEED };
+    const option::Descriptor usage[] =
+    {
+      { UNKNOWN, 0, "", "", Arg::None, "usage: rgsam-gen [options]\n\noptions:" },
+      { OUTPUT, 0, "o", "output", Arg::OutFile,  "  --output    output file [default: stdout]" },
+      { FORMAT, 0, "f", "format", Arg::Some,     "  --format    output file format [sam, fastq]" },
+      { QNFORMAT, 0, "q", "qnformat", Arg::Some, "  --qnformat  read name format [default: illumina-1.8]" },
+      { NREADS, 0, "n", "reads", Arg::Some,      "  --reads     number of reads [default: 100000]" },
+      { LENGTH, 0, "l", "length", Arg::Some,     "  --length    read length, or range as <min>-<max> [default: 100]" },
+      { GROUPS, 0, "g", "groups", Arg::Some,     "  --groups    number of read-groups [default: 8]" },
+      { HEADER, 0, "H", "header", Arg::Some,     "  --header    number of @SQ header lines [default: 25]" },
+      { PATTERN, 0, "p", "pattern", Arg::Some,   "  --pattern   read-group interleaving [sorted, roundrobin, blocks, random]" },
+      { BLOCK, 0, "b", "block", Arg::Some,       "  --block     reads per block for `blocks` pattern [default: 1000]" },
+      { SEED, 0, "s", "seed", Arg::Some,         "  --seed      random seed [default: 1]" },
+      { HELP, 0, "h", "help", Arg::None,         "  --help      print usage and exit" },
+      { 0, 0, 0, 0, 0, 0 }
+    };
+
+    option::Stats stats(usage, argc, argv);
+    option::Option options[stats.options_max], buffer[stats.buffer_max];
+    option::Parser parse(usage, argc, argv, options, buffer);
+
+    if (parse.error()) return 1;
+
+    if (options[HELP]) {
+        option::printUsage(cerr, usage);
+        return 0;
+    }
+
+    params p;
+    p.qnformat = options[QNFORMAT] ? options[QNFORMAT].arg : "illumina-1.8";
+    p.fastq = options[FORMAT] && (strcmp(options[FORMAT].arg, "fastq") == 0 || strcmp(options[FORMAT].arg, "fq") == 0);
+    p.n = options[NREADS] ? strtoull(options[NREADS].arg, NULL, 10) : 100000;
+    p.min_length = p.max_length = 100;
+    if (options[LENGTH]) {
+        char* end;
+        p.min_length = p.max_length = strtoul(options[LENGTH].arg, &end, 10);
+        if (*end == '-') p.max_length = strtoul(end + 1, NULL, 10);
+    }
+    p.groups = options[GROUPS] ? (unsigned int) strtoul(options[GROUPS].arg, NULL, 10) : 8;
+    p.header = options[HEADER] ? (unsigned int) strtoul(options[HEADER].arg, NULL, 10) : 25;
+    p.block = options[BLOCK] ? strtoull(options[BLOCK].arg, NULL, 10) : 1000;
+    unsigned long long seed = options[SEED] ? strtoull(options[SEED].arg, NULL, 10) : 1;
+
+    p.interleave = SORTED;
+    if (options[PATTERN]) {
+        const char* x = options[PATTERN].arg;
+        if (strcmp(x, "sorted") == 0) {
+            p.interleave = SORTED;
+        } else if (strcmp(x, "roundrobin") == 0) {
+            p.interleave = ROUNDROBIN;
+        } else if (strcmp(x, "blocks") == 0) {
+            p.interleave = BLOCKS;
+        } else if (strcmp(x, "random") == 0) {
+            p.interleave = RANDOM;
+        } else {
+            cerr << "Error: unsupported interleaving pattern `" << x << '`' << endl;
+            return 1;
+        }
+    }
+
+    if (p.groups == 0 || p.block == 0 || p.max_length < p.min_length) {
+        cerr << "Error: invalid read-group, block or length parameters" << endl;
+        return 1;
+    }
+
+    try {
+        if (options[OUTPUT] && strcmp(options[OUTPUT].arg, "-") != 0) {
+            ofstream f(options[OUTPUT].arg);
+            generate(f, p, seed);
+        } else {
+            generate(cout, p, seed);
+        }
+    } catch (runtime_error& e) {
+        cerr << "Error: " << e.what() << endl;
+        return 1;
+    }
+
+    return 0;
+}
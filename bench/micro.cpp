@@ -0,0 +1,357 @@
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <list>
+#include <cstring>
+#include <cstdio>
+#include <cstdlib>
+
+#include <time.h>
+
+#include "../rgsam/fastq.hpp"
+#include "../rgsam/sam.hpp"
+#include "../rgsam/string.hpp"
+#include "../rgsam/qname.hpp"
+#include "counters.hpp"
+
+using namespace std;
+
+/**
+ * Microbenchmarks of the parsing and read-group inference hot paths.
+ *
+ * Inputs are read from a corpus directory generated by `make corpus`.
+ * Each benchmark makes one pass over its records per repetition, and the
+ * fastest repetition is reported.
+ *
+ * With `--counters`, hardware performance counters are also read over each
+ * repetition, and IPC, cycles, instructions, cache misses and branch misses
+ * per record of the fastest repetition are reported. Counters that are not
+ * permitted are reported as `-`.
+ */
+
+const char* qnformats[] = { "illumina-1.0", "illumina-1.8", "broad-1.0", "mgi", "pacbio" };
+enum { ILLUMINA10, ILLUMINA18, BROAD10, MGI, PACBIO, n_qnformats };
+
+/**
+ * Benchmark inputs, held in memory.
+ */
+struct corpus {
+    /// SAM entry lines of each read name format (no header lines)
+    vector<string> sam_lines[n_qnformats];
+    /// read names of each read name format
+    vector<string> qnames[n_qnformats];
+    /// optional-field strings of illumina-1.8 SAM entries
+    vector<string> sam_opts;
+    /// parsed illumina-1.8 SAM entries
+    vector<sam::raw_entry> sam_entries;
+    /// illumina-1.8 FASTQ file content
+    string fq_text;
+    /// parsed illumina-1.8 FASTQ entries
+    vector<fastq::entry> fq_entries;
+};
+
+
+/**
+ * Sum of string lengths, plus one newline per string.
+ */
+size_t total_bytes(const vector<string>& xs) {
+    size_t n = 0;
+    for (vector<string>::const_iterator it = xs.begin(); it != xs.end(); ++it) {
+        n += it->length() + 1;
+    }
+    return n;
+}
+
+bool load_corpus(const string& dir, corpus& c) {
+    for (int i = 0; i < n_qnformats; ++i) {
+        string fname = dir + "/" + qnformats[i] + ".sam";
+        ifstream f(fname.c_str());
+        if (!f.good()) {
+            cerr << "Error: could not read " << fname << "; run `make corpus` first" << endl;
+            return false;
+        }
+        string line;
+        while (getline(f, line)) {
+            if (line.empty() || line[0] == '@') continue;
+            c.sam_lines[i].push_back(line);
+            c.qnames[i].push_back(sam::get_qname_from_core(line));
+        }
+    }
+
+    const vector<string>& lines = c.sam_lines[ILLUMINA18];
+    for (vector<string>::const_iterator it = lines.begin(); it != lines.end(); ++it) {
+        size_t pos = find_in_string(*it, sam::delim, 0, sam::n_core_fields);
+        c.sam_opts.push_back(it->substr(pos + 1));
+        sam::raw_entry x;
+        sam::extract_raw_entry(*it, x);
+        c.sam_entries.push_back(x);
+    }
+
+    string fname = dir + "/illumina-1.8.fq";
+    ifstream f(fname.c_str());
+    if (!f.good()) {
+        cerr << "Error: could not read " << fname << "; run `make corpus` first" << endl;
+        return false;
+    }
+    ostringstream ss;
+    ss << f.rdbuf();
+    c.fq_text = ss.str();
+    istringstream fq_f(c.fq_text);
+    while (true) {
+        fastq::entry x;
+        if (!fastq::read_entry(fq_f, x)) break;
+        c.fq_entries.push_back(x);
+    }
+
+    return true;
+}
+
+/**
+ * Benchmark function: process every record once, and return the number of
+ * records and input bytes processed.
+ *
+ * Results are accumulated into `sink` so that the work cannot be elided.
+ */
+typedef void (*bench_fn)(const corpus& c, size_t& records, size_t& bytes, size_t& sink);
+
+void bench_find_in_string(const corpus& c, size_t& records, size_t& bytes, size_t& sink) {
+    const vector<string>& xs = c.sam_lines[ILLUMINA18];
+    for (vector<string>::const_iterator it = xs.begin(); it != xs.end(); ++it) {
+        sink += find_in_string(*it, sam::delim, 0, sam::n_core_fields);
+    }
+    records = xs.size();
+    bytes = total_bytes(xs);
+}
+
+void bench_infer_illumina10(const corpus& c, size_t& records, size_t& bytes, size_t& sink) {
+    const vector<string>& xs = c.qnames[ILLUMINA10];
+    for (vector<string>::const_iterator it = xs.begin(); it != xs.end(); ++it) {
+        string rg;
+        infer_read_group_illumina10(*it, rg);
+        sink += rg.length();
+    }
+    records = xs.size();
+    bytes = total_bytes(xs);
+}
+
+void bench_infer_illumina18(const corpus& c, size_t& records, size_t& bytes, size_t& sink) {
+    const vector<string>& xs = c.qnames[ILLUMINA18];
+    for (vector<string>::const_iterator it = xs.begin(); it != xs.end(); ++it) {
+        string rg;
+        infer_read_group_illumina18(*it, rg);
+        sink += rg.length();
+    }
+    records = xs.size();
+    bytes = total_bytes(xs);
+}
+
+void bench_infer_broad10(const corpus& c, size_t& records, size_t& bytes, size_t& sink) {
+    const vector<string>& xs = c.qnames[BROAD10];
+    for (vector<string>::const_iterator it = xs.begin(); it != xs.end(); ++it) {
+        string rg;
+        infer_read_group_broad10(*it, rg);
+        sink += rg.length();
+    }
+    records = xs.size();
+    bytes = total_bytes(xs);
+}
+
+void bench_infer_mgi(const corpus& c, size_t& records, size_t& bytes, size_t& sink) {
+    const vector<string>& xs = c.qnames[MGI];
+    for (vector<string>::const_iterator it = xs.begin(); it != xs.end(); ++it) {
+        string rg;
+        infer_read_group_mgi(*it, rg);
+        sink += rg.length();
+    }
+    records = xs.size();
+    bytes = total_bytes(xs);
+}
+
+void bench_infer_pacbio(const corpus& c, size_t& records, size_t& bytes, size_t& sink) {
+    const vector<string>& xs = c.qnames[PACBIO];
+    for (vector<string>::const_iterator it = xs.begin(); it != xs.end(); ++it) {
+        string rg;
+        infer_read_group_pacbio(*it, rg);
+        sink += rg.length();
+    }
+    records = xs.size();
+    bytes = total_bytes(xs);
+}
+
+void bench_infer_read_group(const corpus& c, size_t& records, size_t& bytes, size_t& sink) {
+    const vector<string>& xs = c.qnames[BROAD10];
+    for (vector<string>::const_iterator it = xs.begin(); it != xs.end(); ++it) {
+        string rg;
+        infer_read_group("broad-1.0", *it, rg);
+        sink += rg.length();
+    }
+    records = xs.size();
+    bytes = total_bytes(xs);
+}
+
+void bench_extract_raw_entry(const corpus& c, size_t& records, size_t& bytes, size_t& sink) {
+    const vector<string>& xs = c.sam_lines[ILLUMINA18];
+    for (vector<string>::const_iterator it = xs.begin(); it != xs.end(); ++it) {
+        sam::raw_entry x;
+        sam::extract_raw_entry(*it, x);
+        sink += x.core.length() + x.opts.size();
+    }
+    records = xs.size();
+    bytes = total_bytes(xs);
+}
+
+void bench_parse_opts(const corpus& c, size_t& records, size_t& bytes, size_t& sink) {
+    const vector<string>& xs = c.sam_opts;
+    for (vector<string>::const_iterator it = xs.begin(); it != xs.end(); ++it) {
+        list<sam::opt_field> opts;
+        sam::parse_opts(*it, opts);
+        sink += opts.size();
+    }
+    records = xs.size();
+    bytes = total_bytes(xs);
+}
+
+void bench_fastq_read_entry(const corpus& c, size_t& records, size_t& bytes, size_t& sink) {
+    istringstream f(c.fq_text);
+    records = 0;
+    while (true) {
+        fastq::entry x;
+        if (!fastq::read_entry(f, x)) break;
+        sink += x.seq.length();
+        ++records;
+    }
+    bytes = c.fq_text.length();
+}
+
+void bench_fastq_write_entry(const corpus& c, size_t& records, size_t& bytes, size_t& sink) {
+    ofstream f("/dev/null");
+    const vector<fastq::entry>& xs = c.fq_entries;
+    bytes = 0;
+    for (vector<fastq::entry>::const_iterator it = xs.begin(); it != xs.end(); ++it) {
+        fastq::write_entry(f, *it);
+        bytes += fastq::entry_size(*it);
+    }
+    records = xs.size();
+    sink += f.good();
+}
+
+void bench_sam_write_raw_entry(const corpus& c, size_t& records, size_t& bytes, size_t& sink) {
+    ofstream f("/dev/null");
+    const vector<sam::raw_entry>& xs = c.sam_entries;
+    for (vector<sam::raw_entry>::const_iterator it = xs.begin(); it != xs.end(); ++it) {
+        sam::write_raw_entry(f, *it);
+    }
+    records = xs.size();
+    bytes = total_bytes(c.sam_lines[ILLUMINA18]);
+    sink += f.good();
+}
+
+struct benchmark {
+    const char* name;
+    bench_fn fn;
+};
+
+const benchmark benchmarks[] = {
+    { "find_in_string", bench_find_in_string },
+    { "infer_read_group_illumina10", bench_infer_illumina10 },
+    { "infer_read_group_illumina18", bench_infer_illumina18 },
+    { "infer_read_group_broad10", bench_infer_broad10 },
+    { "infer_read_group_mgi", bench_infer_mgi },
+    { "infer_read_group_pacbio", bench_infer_pacbio },
+    { "infer_read_group", bench_infer_read_group },
+    { "sam::extract_raw_entry", bench_extract_raw_entry },
+    { "sam::parse_opts", bench_parse_opts },
+    { "sam::write_raw_entry", bench_sam_write_raw_entry },
+    { "fastq::read_entry", bench_fastq_read_entry },
+    { "fastq::write_entry", bench_fastq_write_entry },
+    { NULL, NULL }
+};
+
+double now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/**
+ * Print a count per record, or `-` if the counter is unavailable.
+ */
+void print_per_record(const hw_counters& hw, hw_counters::event e, const unsigned long long* counts, size_t records) {
+    if (hw.available(e) && records > 0) {
+        printf(" %10.2f", (double) counts[e] / records);
+    } else {
+        printf(" %10s", "-");
+    }
+}
+
+int main(int argc, char* argv[]) {
+    bool use_counters = false;
+    if (argc > 1 && strcmp(argv[1], "--counters") == 0) {
+        use_counters = true;
+        --argc; ++argv;
+    }
+
+    string dir = argc > 1 ? argv[1] : "tmp/corpus";
+    int reps = argc > 2 ? atoi(argv[2]) : 5;
+    const char* filter = argc > 3 ? argv[3] : NULL;
+
+    corpus c;
+    if (!load_corpus(dir, c)) return 1;
+
+    hw_counters hw;
+    if (use_counters && !hw.good()) {
+        cerr << "Warning: hardware performance counters are not permitted; "
+                "check /proc/sys/kernel/perf_event_paranoid" << endl;
+    }
+
+    size_t sink = 0;
+    printf("%-30s %12s %12s %12s", "benchmark", "records", "ns/record", "MB/s");
+    if (use_counters) {
+        printf(" %10s %10s %10s %10s %10s", "IPC", "cyc/rec", "ins/rec", "cmiss/rec", "bmiss/rec");
+    }
+    printf("\n");
+    for (const benchmark* b = benchmarks; b->name != NULL; ++b) {
+        if (filter != NULL && strstr(b->name, filter) == NULL) continue;
+
+        double best = 0;
+        size_t records = 0, bytes = 0;
+        unsigned long long counts[hw_counters::n_events] = { 0 };
+        for (int r = 0; r < reps; ++r) {
+            if (use_counters) hw.start();
+            double start = now_ns();
+            b->fn(c, records, bytes, sink);
+            double elapsed = now_ns() - start;
+            if (use_counters) hw.stop();
+            if (r == 0 || elapsed < best) {
+                best = elapsed;
+                for (int i = 0; i < hw_counters::n_events; ++i) {
+                    counts[i] = hw[static_cast<hw_counters::event>(i)];
+                }
+            }
+        }
+
+        printf("%-30s %12lu %12.1f %12.1f", b->name, (unsigned long) records,
+                records > 0 ? best / records : 0.0, bytes / best * 1e3);
+        if (use_counters) {
+            if (hw.available(hw_counters::CYCLES) && hw.available(hw_counters::INSTRUCTIONS)
+                    && counts[hw_counters::CYCLES] > 0) {
+                printf(" %10.2f", (double) counts[hw_counters::INSTRUCTIONS] / counts[hw_counters::CYCLES]);
+            } else {
+                printf(" %10s", "-");
+            }
+            print_per_record(hw, hw_counters::CYCLES, counts, records);
+            print_per_record(hw, hw_counters::INSTRUCTIONS, counts, records);
+            print_per_record(hw, hw_counters::CACHE_MISSES, counts, records);
+            print_per_record(hw, hw_counters::BRANCH_MISSES, counts, records);
+        }
+        printf("\n");
+    }
+
+    // keep the accumulated results observable
+    volatile size_t result = sink;
+    (void) result;
+
+    return 0;
+}
@@ -12,7 +12,18 @@
 #include "rgsam/fastq.hpp"
 #include "rgsam/sam.hpp"
 #include "rgsam/string.hpp"
+#include "rgsam/qname.hpp"
 #include "rgsam/file.hpp"
+#include "rgsam/spool.hpp"
+#include "rgsam/summary.hpp"
+#include "rgsam/index.hpp"
+#include "rgsam/profile.hpp"
+#include "rgsam/progress.hpp"
+#include "rgsam/metrics.hpp"
+#include "rgsam/diagnostics.hpp"
+#include "rgsam/barcode.hpp"
+#include "rgsam/key.hpp"
+#include "rgsam/coords.hpp"
 
 using namespace std;
 
@@ -57,6 +68,10 @@ namespace file_format {
         }
         return f;
     }
+
+    const char* name(Format f) {
+        return f == FASTQ ? "fastq" : "sam";
+    }
 }
 
 template <class ptr>
@@ -73,242 +88,579 @@ struct files {
 };
 
 /**
- * Infer read-group based on flowcell id and lane id,
- * assuming Illumina v1.0 read name format.
+ * Write read-group offset index to file.
+ */
+void write_rg_index(const char* index_fname, const rg_index::runs& idx) {
+    ofstream index_f(index_fname);
+    rg_index::write(index_f, idx);
+    index_f.close();
+}
+
+/**
+ * Write read-group summary to file.
  */
-void infer_read_group_illumina10(const string& qname, string& rg) {
-    // extract flowcell
-    size_t start = 0;
-    size_t end = find_in_string(qname, '-', start, 1);
-    if (end == string::npos) return;
-    string flowcell = qname.substr(start, end - start);
-
-    // extract lane
-    start = find_in_string(qname, ':', end + 1, 1);
-    if (start == string::npos) return;
-    ++start;
-    end = find_in_string(qname, ':', start, 1);
-    if (end == string::npos) return;
-    string lane = qname.substr(start, end - start);
-
-    rg = flowcell + '_' + lane;
+void write_rg_summary(const char* summary_fname, const summary::rg_counts& counts, const map<string, string>& rgs, const char* format) {
+    ofstream summary_f(summary_fname);
+    summary::write(summary_f, counts, rgs, format);
+    summary_f.close();
 }
 
 /**
- * Infer read-group based on flowcell id and lane id,
- * assuming Illumina v1.8 read name format.
+ * Create the header lines of read-groups, keeping the input header line of a
+ * read-group in `rg_lines`, if any.
  */
-void infer_read_group_illumina18(const string& qname, string& rg) {
-    // extract flowcell
-    size_t start = find_in_string(qname, ':', 0, 2);
-    if (start == string::npos) return;
-    ++start;
-    size_t end = find_in_string(qname, ':', start, 1);
-    if (end == string::npos) return;
-    string flowcell = qname.substr(start, end - start);
-
-    // extract lane
-    start = end + 1;
-    end = find_in_string(qname, ':', start, 1);
-    if (end == string::npos) return;
-    string lane = qname.substr(start, end - start);
-
-    rg = flowcell + '_' + lane;
+void make_read_groups(const set<string>& rgs, const map<string, string>& rg_lines, const char* sample, const char* library, const char* platform, map<string, string>& out) {
+    sam::make_read_groups(rgs, sample, library, platform, out);
+    for (map<string, string>::iterator it = out.begin(); it != out.end(); ++it) {
+        map<string, string>::const_iterator in = rg_lines.find(it->first);
+        if (in != rg_lines.end()) it->second = in->second;
+    }
 }
 
 /**
- * Infer read-group based on flowcell id and lane id,
- * assuming Broad v1.0 read name format.
+ * Whether read-groups are taken from an optional field (`tag:{XX}` formats)
+ * rather than inferred from read names.
  */
-void infer_read_group_broad10(const string& qname, string& rg) {
-    // extract flowcell
-    string flowcell = qname.substr(0, 5);
-
-    // extract lane
-    size_t start = find_in_string(qname, ':', 5, 1);
-    if (start == string::npos) return;
-    ++start;
-    size_t end = find_in_string(qname, ':', start, 1);
-    if (end == string::npos) return;
-    string lane = qname.substr(start, end - start);
-
-    rg = flowcell + '_' + lane;
+inline bool tag_format(const char* format) {
+    return strncmp(format, "tag:", 4) == 0;
 }
 
 /**
- * Infer read-group based on flowcell id and lane id.
+ * Infer read-group of a SAM entry line from `p` to `end`: from its read name,
+ * or for a `tag:{XX}` format, from the value of its optional field XX.
+ *
+ * `qname` receives the read name in either case. If `fields` is given, it
+ * receives the positions of the fields of the read name (see
+ * `infer_read_group`); they are all missing for a `tag:` format.
  */
-void infer_read_group(const char* format, const string& qname, string& rg) {
-    if (strcmp(format, "illumina-1.0") == 0) {
-        infer_read_group_illumina10(qname, rg);
-    } else if (strcmp(format, "illumina-1.8") == 0) {
-        infer_read_group_illumina18(qname, rg);
-    } else if (strcmp(format, "broad-1.0") == 0) {
-        infer_read_group_broad10(qname, rg);
+void infer_read_group_sam(const char* format, const char* p, const char* end, string& qname, string& rg, qname_fields::range* fields = NULL) {
+    const char* tab = static_cast<const char*>(memchr(p, sam::delim, end - p));
+    qname.assign(p, tab == NULL ? end : tab);
+
+    if (tag_format(format)) {
+        const char* tag = format + 4;
+        if (strlen(tag) != 2) throw runtime_error("Unsupported read format");
+        const char* value;
+        size_t len;
+        if (sam::find_opt_value(p, end, tag, value, len)) {
+            rg.assign(value, len);
+        } else {
+            rg.clear();
+        }
+        if (fields != NULL) qname_fields::clear(fields);
     } else {
-        throw runtime_error("Unsupported read format");
+        infer_read_group(format, qname, rg, fields);
     }
 }
 
+inline void infer_read_group_sam(const char* format, const string& line, string& qname, string& rg, qname_fields::range* fields = NULL) {
+    infer_read_group_sam(format, line.data(), line.data() + line.length(), qname, rg, fields);
+}
+
+/**
+ * Warn about a SAM entry whose read-group could not be inferred.
+ */
+inline void warn_unmatched(const char* format, const string& qname) {
+    diagnostics::warn(tag_format(format) ? diagnostics::MISSING_TAG : diagnostics::UNMATCHED_QNAME, "", qname);
+}
+
+/**
+ * Write the read-group header file of FASTQ reads, and their summary if
+ * `summary_fname` is given.
+ *
+ * Read-groups with a line in `rg_lines` (from a barcode sheet) keep it; the
+ * others get the given sample, library and platform.
+ */
+void write_fq_read_groups(const char* out_rg_fname, const char* summary_fname, const summary::rg_counts* counts, const set<string>& rgs, const map<string, string>& rg_lines, const char* sample, const char* library, const char* platform, const char* format) {
+    map<string, string> out_rg_lines;
+    sam::make_read_groups(rgs, sample, library, platform, out_rg_lines);
+    for (map<string, string>::iterator it = out_rg_lines.begin(); it != out_rg_lines.end(); ++it) {
+        map<string, string>::const_iterator in = rg_lines.find(it->first);
+        if (in != rg_lines.end()) it->second = in->second;
+    }
+
+    ofstream rg_f(out_rg_fname);
+    sam::write_read_groups(rg_f, out_rg_lines);
+    rg_f << "@CO\t" << "QF:" << format << endl;
+    rg_f.close();
+
+    if (summary_fname != NULL) {
+        write_rg_summary(summary_fname, *counts, out_rg_lines, format);
+    }
+}
 
-void collect_rg_from_sam(const char* format, const char* in_fname, const char* sample, const char* library, const char* platform, const char* out_rg_fname) {
+/**
+ * Collect read-groups from SAM file.
+ *
+ * With the `tag:RG` format, the input `@RG` header lines of the read-groups
+ * are kept.
+ *
+ * If `xy` is given, the cluster coordinates of each read are added to it.
+ */
+void collect_rg_from_sam(const char* format, const char* in_fname, const char* sample, const char* library, const char* platform, const char* out_rg_fname, const char* index_fname, const char* summary_fname, summary::rg_counts* counts, coords::writer* xy) {
     // collect read-groups
     set<string> rgs;
+    map<string, string> rg_lines;
+    bool keep_rg_lines = strcmp(format, "tag:RG") == 0;
+    rg_index::runs idx;
+    profile::stopwatch sw;
     ifstream sam_f(in_fname);
+    // reused for every entry
+    string line, qname, rg;
+    qname_fields::range fields[qname_fields::n_fields];
     while (true) {
-        string line;
         getline(sam_f, line);
+        sw.lap(profile::READ);
 
         if (line.empty()) break;
 
+        unsigned long long offset = idx.size;
+        idx.size += line.length() + (sam_f.eof() ? 0 : 1);
+        sw.bytes_in(idx.size - offset);
+
         // skip header lines
-        if (line[0] == '@') continue;
+        if (line[0] == '@') {
+            if (keep_rg_lines && sam::get_read_group_id(line, qname)) {
+                rg_lines[qname] = line;
+            }
+            continue;
+        }
 
-        // infer read-group
-        sam::raw_entry x; 
-        if (!sam::extract_raw_entry(line, x)) break;
-        string rg;
-        infer_read_group(format, sam::get_qname_from_core(x.core), rg);
+        // infer read-group; only the core fields (or the one optional field
+        // of a `tag:` format) are looked at, so the entry is not parsed
+        infer_read_group_sam(format, line, qname, rg, xy != NULL ? fields : NULL);
+        if (rg.empty()) {
+            warn_unmatched(format, qname);
+        }
         rgs.insert(rg);
+        sw.groups(rgs.size());
+
+        if (xy != NULL) {
+            xy->add(qname, fields, rg);
+        }
+        if (index_fname != NULL) {
+            idx.add(rg, offset, idx.size);
+        }
+        if (counts != NULL) {
+            (*counts)[rg].add(sam::get_seq_length_from_core(line));
+        }
+        sw.lap(profile::INFER);
+        sw.record();
     }
     sam_f.close();
 
     // write all read groups
+    map<string, string> out_rg_lines;
+    make_read_groups(rgs, rg_lines, sample, library, platform, out_rg_lines);
     ofstream rg_f(out_rg_fname);
-    sam::write_read_groups(rg_f, rgs, sample, library, platform);
+    sam::write_read_groups(rg_f, out_rg_lines);
     rg_f << "@CO\t" << "QF:" << format << endl;
     rg_f.close();
+
+    if (index_fname != NULL) {
+        write_rg_index(index_fname, idx);
+    }
+    if (summary_fname != NULL) {
+        write_rg_summary(summary_fname, *counts, out_rg_lines, format);
+    }
 }
 
-void split_sam_by_rg(const char* format, const char* in_fname, const char* sample, const char* library, const char* platform, const char* out_rg_fname) {
+/**
+ * Split SAM file into one file per read-group.
+ *
+ * If `tag` is set, each output also receives its own `@RG` header line and
+ * its reads are tagged with the read-group field. Otherwise, reads are copied
+ * unchanged, and each output keeps the input `@RG` header line of its
+ * read-group, if any; with the `tag:RG` format, the input is thereby split by
+ * its existing read-groups.
+ *
+ * If `k` is given, reads are split by the values of its read name fields
+ * instead; each output then holds all input `@RG` header lines, since it may
+ * hold reads of several read-groups. Reads cannot then be tagged.
+ *
+ * Read and base counts of each read-group are added to `counts` if it is
+ * given; it is required if `summary_fname` is given.
+ */
+void split_sam_by_rg(const char* format, const char* in_fname, const char* sample, const char* library, const char* platform, const char* out_rg_fname, bool tag, const char* summary_fname, summary::rg_counts* counts, const key::spec* k) {
     // collect read-groups and write reads to separate files
     files<ofstream*> outs;
     set<string> rgs;
     vector<string> header_lines;
+    map<string, string> rg_lines;
+    profile::stopwatch sw;
     ifstream sam_f(in_fname);
+    // reused for every entry
+    string line, qname, rg, part;
+    qname_fields::range fields[qname_fields::n_fields];
+    sam::raw_entry x;
     while (true) {
-        string line;
         getline(sam_f, line);
+        sw.lap(profile::READ);
 
         if (line.empty()) break;
+        sw.bytes_in(line.length() + 1);
 
         // skip header lines
         if (line[0] == '@') {
             if (line.find("@RG") != 0) {
                 header_lines.push_back(line);
+            } else if (!tag && sam::get_read_group_id(line, qname)) {
+                rg_lines[qname] = line;
             }
             continue;
         }
 
-        // infer read-group
-        sam::raw_entry x; 
-        if (!sam::extract_raw_entry(line, x)) break;
-        string rg;
-        infer_read_group(format, sam::get_qname_from_core(x.core), rg);
+        // infer read-group, and the key of its output
+        infer_read_group_sam(format, line, qname, rg, k != NULL ? fields : NULL);
+        if (rg.empty()) {
+            warn_unmatched(format, qname);
+        }
+        if (k != NULL) {
+            k->make(qname, fields, part);
+            if (part.empty() && !rg.empty()) {
+                diagnostics::warn(diagnostics::MISSING_KEY_FIELD, rg, qname);
+            }
+        }
+        const string& out_key = k != NULL ? part : rg;
+        sw.lap(profile::INFER);
 
-        if (rgs.find(rg) == rgs.end()) {
-            // new read-group: create new output file
-            rgs.insert(rg);
+        if (rgs.insert(rg).second) {
+            sw.groups(rgs.size());
+        }
+
+        files<ofstream*>::map_t::iterator out = outs.rep.find(out_key);
+        if (out == outs.rep.end()) {
+            // new output key: create new output file
             string new_sam_fname;
             if (strcmp(in_fname, "/dev/stdin") == 0) {
-                new_sam_fname = new_sam_fname + sample + "_" + library + "_" + rg + ".sam";
+                new_sam_fname = new_sam_fname + sample + "_" + library + "_" + out_key + ".sam";
             } else {
-                new_sam_fname = new_sam_fname + in_fname + "." + rg;
+                new_sam_fname = new_sam_fname + in_fname + "." + out_key;
             }
             cerr << "Info: create output " << new_sam_fname << endl;
-            outs.rep[rg] = new ofstream(new_sam_fname.c_str());
+            out = outs.rep.insert(make_pair(out_key, new ofstream(new_sam_fname.c_str()))).first;
+            ofstream& out_f = *out->second;
             // write header lines
             for (vector<string>::const_iterator it = header_lines.begin(); it != header_lines.end(); ++it) {
-                *outs.rep[rg] << *it << endl;
+                out_f << *it << endl;
             }
-            *outs.rep[rg] << "@CO\t" << "QF:" << format << endl;
+            if (tag) {
+                out_f << sam::read_group_line(rg, sample, library, platform) << endl;
+            } else if (k != NULL) {
+                // reads of any read-group may follow
+                sam::write_read_groups(out_f, rg_lines);
+            } else if (rg_lines.find(rg) != rg_lines.end()) {
+                out_f << rg_lines[rg] << endl;
+            }
+            out_f << "@CO\t" << "QF:" << format << endl;
         }
-        
-        sam::write_raw_entry(*outs.rep[rg], x);
+        ofstream& out_f = *out->second;
+
+        if (counts != NULL) {
+            (*counts)[rg].add(sam::get_seq_length_from_core(line));
+        }
+
+        if (tag) {
+            sw.lap(profile::WRITE);
+            if (!sam::extract_raw_entry(line, x)) break;
+            sw.lap(profile::PARSE);
+            sam::replace_opt_field(x, sam::read_group_field(rg));
+            sw.lap(profile::REWRITE);
+            sam::write_raw_entry(out_f, x);
+            sw.entry_out(x);
+        } else {
+            // copy entry without parsing it
+            out_f << line << '\n';
+            sw.bytes_out(line.length() + 1);
+        }
+        sw.lap(profile::WRITE);
+        sw.record();
     }
     sam_f.close();
 
-    // write all read groups
+    // write all read groups, keeping input header lines of untagged outputs
+    map<string, string> out_rg_lines;
+    make_read_groups(rgs, rg_lines, sample, library, platform, out_rg_lines);
     ofstream rg_f(out_rg_fname);
-    sam::write_read_groups(rg_f, rgs, sample, library, platform);
+    sam::write_read_groups(rg_f, out_rg_lines);
     rg_f << "@CO\t" << "QF:" << format << endl;
     rg_f.close();
+
+    if (summary_fname != NULL) {
+        write_rg_summary(summary_fname, *counts, out_rg_lines, format);
+    }
 }
 
-void collect_rg_from_fq(const char* format, const char* in_fname, const char* sample, const char* library, const char* platform, const char* out_rg_fname) {
+/**
+ * Collect read-groups from FASTQ file.
+ *
+ * If `barcodes` is given, reads are further assigned to samples by the index
+ * sequence in their names, and each read-group is suffixed by the sample.
+ *
+ * If `xy` is given, the cluster coordinates of each read are added to it.
+ */
+void collect_rg_from_fq(const char* format, const char* in_fname, const char* sample, const char* library, const char* platform, const char* out_rg_fname, const char* index_fname, const char* summary_fname, summary::rg_counts* counts, const barcode::sheet* barcodes, coords::writer* xy) {
     // collect read-groups
     set<string> rgs;
+    // header lines of demultiplexed read-groups
+    map<string, string> rg_lines;
+    rg_index::runs idx;
+    profile::stopwatch sw;
     ifstream fq_f(in_fname);
+    // reused for every entry
+    fastq::entry x;
+    string qname, rg;
+    qname_fields::range fields[qname_fields::n_fields];
     while (true) {
-        fastq::entry x;
         if (!fastq::read_entry(fq_f, x)) break;
+        sw.lap(profile::READ);
+
+        unsigned long long offset = idx.size;
+        idx.size += fastq::entry_size(x) - (fq_f.eof() ? 1 : 0);
+        sw.bytes_in(idx.size - offset);
     
         // infer read-group
-        string rg;
-        infer_read_group(format, x.qname.substr(1), rg);
+        qname.assign(x.qname, 1, string::npos);
+        infer_read_group(format, qname, rg, xy != NULL ? fields : NULL);
+        if (rg.empty()) {
+            diagnostics::warn(diagnostics::UNMATCHED_QNAME, rg, qname);
+        } else if (barcodes != NULL) {
+            int s = barcodes->append_sample(qname, rg);
+            if (rg_lines.find(rg) == rg_lines.end()) {
+                rg_lines[rg] = barcodes->read_group_line(rg, s, sample, library, platform);
+            }
+        }
         rgs.insert(rg);
+        sw.groups(rgs.size());
+
+        if (xy != NULL) {
+            xy->add(qname, fields, rg);
+        }
+        if (index_fname != NULL) {
+            idx.add(rg, offset, idx.size);
+        }
+        if (counts != NULL) {
+            (*counts)[rg].add(x.seq.length());
+        }
+        sw.lap(profile::INFER);
+        sw.record();
     }
     fq_f.close();
 
     // write all read groups
-    ofstream rg_f(out_rg_fname);
-    sam::write_read_groups(rg_f, rgs, sample, library, platform);
-    rg_f << "@CO\t" << "QF:" << format << endl;
-    rg_f.close();
+    write_fq_read_groups(out_rg_fname, summary_fname, counts, rgs, rg_lines, sample, library, platform, format);
+
+    if (index_fname != NULL) {
+        write_rg_index(index_fname, idx);
+    }
 }
 
-void split_fq_by_rg(const char* format, const char* in_fname, const char* sample, const char* library, const char* platform, const char* out_rg_fname) {
+/**
+ * Split FASTQ file into one file per read-group.
+ *
+ * If `k` is given, reads are split by the values of its read name fields
+ * instead; the read-group header file still lists the inferred read-groups.
+ *
+ * If `barcodes` is given, reads are further assigned to samples by the index
+ * sequence in their names, so that each output holds one sample of a lane.
+ */
+void split_fq_by_rg(const char* format, const char* in_fname, const char* sample, const char* library, const char* platform, const char* out_rg_fname, const char* summary_fname, summary::rg_counts* counts, const barcode::sheet* barcodes, const key::spec* k) {
     // collect read-groups and write reads to separate files
     files<ofstream*> outs;
     set<string> rgs;
+    // header lines of demultiplexed read-groups
+    map<string, string> rg_lines;
+    profile::stopwatch sw;
     ifstream fq_f(in_fname);
+    // reused for every entry
+    fastq::entry x;
+    string qname, rg, part;
+    qname_fields::range fields[qname_fields::n_fields];
     while (true) {
-        fastq::entry x;
         if (!fastq::read_entry(fq_f, x)) break;
+        sw.lap(profile::READ);
+        sw.entry_in(x);
+
+        // infer read-group, and the key of its output
+        qname.assign(x.qname, 1, string::npos);
+        infer_read_group(format, qname, rg, k != NULL ? fields : NULL);
+        if (rg.empty()) {
+            diagnostics::warn(diagnostics::UNMATCHED_QNAME, rg, qname);
+        } else if (barcodes != NULL) {
+            int s = barcodes->append_sample(qname, rg);
+            if (rg_lines.find(rg) == rg_lines.end()) {
+                rg_lines[rg] = barcodes->read_group_line(rg, s, sample, library, platform);
+            }
+        }
+        if (k != NULL) {
+            k->make(qname, fields, part);
+            if (part.empty() && !rg.empty()) {
+                diagnostics::warn(diagnostics::MISSING_KEY_FIELD, rg, qname);
+            }
+        }
+        const string& out_key = k != NULL ? part : rg;
+        sw.lap(profile::INFER);
 
-        // infer read-group
-        string rg;
-        infer_read_group(format, x.qname.substr(1), rg);
+        if (rgs.insert(rg).second) {
+            sw.groups(rgs.size());
+        }
 
-        if (rgs.find(rg) == rgs.end()) {
-            // new read-group: create new output file
-            rgs.insert(rg);
+        files<ofstream*>::map_t::iterator out = outs.rep.find(out_key);
+        if (out == outs.rep.end()) {
+            // new output key: create new output file
             string new_fq_fname;
             if (strcmp(in_fname, "/dev/stdin") == 0) {
-                new_fq_fname = new_fq_fname + sample + "_" + library + "_" + rg + ".fq";
+                new_fq_fname = new_fq_fname + sample + "_" + library + "_" + out_key + ".fq";
             } else {
-                new_fq_fname = new_fq_fname + in_fname + "." + rg;
+                new_fq_fname = new_fq_fname + in_fname + "." + out_key;
             }
             cerr << "Info: create output " << new_fq_fname << endl;
-            outs.rep[rg] = new ofstream(new_fq_fname.c_str());
+            out = outs.rep.insert(make_pair(out_key, new ofstream(new_fq_fname.c_str()))).first;
         }
         
-        fastq::write_entry(*outs.rep[rg], x);
+        if (counts != NULL) {
+            (*counts)[rg].add(x.seq.length());
+        }
+        
+        fastq::write_entry(*out->second, x);
+        sw.entry_out(x);
+        sw.lap(profile::WRITE);
+        sw.record();
     }
     fq_f.close();
 
     // write all read groups
-    ofstream rg_f(out_rg_fname);
-    sam::write_read_groups(rg_f, rgs, sample, library, platform);
-    rg_f << "@CO\t" << "QF:" << format << endl;
-    rg_f.close();
+    write_fq_read_groups(out_rg_fname, summary_fname, counts, rgs, rg_lines, sample, library, platform, format);
+}
+
+/**
+ * Collect read-groups from a seekable SAM file in one pass over its memory map.
+ */
+void collect_rg_ids_from_mapped_sam(const char* format, const char* in_fname, set<string>& rgs) {
+    mapped_file sam_f(in_fname);
+    if (!sam_f.good()) throw runtime_error("could not map input file");
+
+    const char* p = sam_f.data;
+    const char* end = p + sam_f.size;
+    string qname, rg;
+    profile::stopwatch sw;
+    while (p < end) {
+        const char* eol = static_cast<const char*>(memchr(p, '\n', end - p));
+        if (eol == NULL) eol = end;
+        if (eol == p) break;
+        sw.bytes_in(eol - p + 1);
+
+        // skip header lines
+        if (*p != '@') {
+            sw.lap(profile::READ);
+
+            // infer read-group
+            infer_read_group_sam(format, p, eol, qname, rg);
+            rgs.insert(rg);
+            sw.groups(rgs.size());
+            sw.lap(profile::INFER);
+        }
+
+        p = eol + 1;
+    }
+}
+
+/**
+ * Storage for one SAM entry and its read-group, reused across entries.
+ */
+struct sam_scratch {
+    sam::raw_entry x;
+    string qname;
+    string rg;
+    qname_fields::range fields[qname_fields::n_fields];
+};
+
+/**
+ * Tag one SAM entry with its inferred read-group and write it to file.
+ *
+ * Read and base counts are added to `counts` if it is given, and cluster
+ * coordinates to `xy`.
+ */
+bool tag_sam_entry(const char* format, const string& line, const map<string, string>& rgs, ostream& out_f, summary::rg_counts* counts, coords::writer* xy, sam_scratch& scratch, profile::stopwatch& sw) {
+    sam::raw_entry& x = scratch.x;
+    if (!sam::extract_raw_entry(line, x)) return false;
+    sw.lap(profile::PARSE);
+
+    string& rg = scratch.rg;
+    infer_read_group_sam(format, line, scratch.qname, rg, xy != NULL ? scratch.fields : NULL);
+
+    if (counts != NULL) {
+        (*counts)[rg].add(sam::get_seq_length_from_core(x.core));
+    }
+
+    if (rg.empty()) {
+        warn_unmatched(format, scratch.qname);
+    } else if (rgs.find(rg) == rgs.end()) {
+        diagnostics::warn(diagnostics::UNKNOWN_READ_GROUP, rg, scratch.qname);
+    }
+
+    if (xy != NULL) {
+        xy->add(scratch.qname, scratch.fields, rg);
+    }
+    
+    sw.lap(profile::INFER);
+    
+    // tag read with inferred read group
+    sam::replace_opt_field(x, sam::read_group_field(rg));
+    sw.lap(profile::REWRITE);
+
+    // write modified SAM entry to out file
+    sam::write_raw_entry(out_f, x);
+    sw.entry_out(x);
+    sw.lap(profile::WRITE);
+    sw.record();
+
+    return true;
 }
 
-void tag_sam_with_rg(const char* format, const char* in_fname, const char* rg_fname, const char* out_sam_fname) {
-    ifstream rg_f(rg_fname);
+/**
+ * Tag reads in SAM file with read-group field.
+ *
+ * If no read-group header file is given, the read-groups are collected from
+ * the input itself: by an extra pass over a seekable input, or otherwise by
+ * spooling the reads to a temporary file while they are being collected.
+ *
+ * Read and base counts of each read-group are added to `counts` if it is
+ * given. If `summary_fname` is given, the header lines of the read-groups
+ * seen and their read and base counts are written to it; `counts` is then
+ * required.
+ *
+ * If `xy` is given, the cluster coordinates of each read are added to it.
+ */
+void tag_sam_with_rg(const char* format, const char* in_fname, const char* rg_fname, const char* sample, const char* library, const char* platform, const char* out_sam_fname, const char* summary_fname, summary::rg_counts* counts, coords::writer* xy) {
     map<string, string> rgs;
-    sam::read_read_groups(rg_f, rgs);
-    rg_f.close();
+    bool spooled = false;
+    if (rg_fname != NULL) {
+        ifstream rg_f(rg_fname);
+        sam::read_read_groups(rg_f, rgs);
+        rg_f.close();
+    } else if (file_seekable(in_fname)) {
+        set<string> rg_ids;
+        collect_rg_ids_from_mapped_sam(format, in_fname, rg_ids);
+        reset_format_hits();
+        sam::make_read_groups(rg_ids, sample, library, platform, rgs);
+    } else {
+        spooled = true;
+    }
 
     ifstream in_f(in_fname);
     ofstream out_f(out_sam_fname);
+    profile::stopwatch sw;
 
     string line;
+    sam_scratch scratch;
 
     while (true) {
         getline(in_f, line);
+        sw.lap(profile::READ);
 
         if (line.empty()) break;
+        sw.bytes_in(line.length() + 1);
 
         if (line[0] == '@') {
             // skip RG header line but copy other header lines verbatim
@@ -321,35 +673,171 @@ void tag_sam_with_rg(const char* format, const char* in_fname, const char* rg_fn
         }
     }
 
-    // write read-group header
-    sam::write_read_groups(out_f, rgs);
-    out_f << "@CO\t" << "QF:" << format << endl;
-    
-    // process SAM entries
-    while (true) {
-        sam::raw_entry x; 
-        if (!sam::extract_raw_entry(line, x)) break;
+    if (spooled) {
+        // input can only be read once: hold the SAM entries in a temporary 
+        // file while collecting read-groups, then replay them
+        spool spool_f;
+        set<string> rg_ids;
+        while (!line.empty()) {
+            string& rg = scratch.rg;
+            infer_read_group_sam(format, line, scratch.qname, rg);
+            rg_ids.insert(rg);
+            sw.groups(rg_ids.size());
+            sw.lap(profile::INFER);
+            spool_f.write(line);
+            sw.lap(profile::COMPRESS);
+
+            getline(in_f, line);
+            sw.lap(profile::READ);
+            sw.bytes_in(line.length() + 1);
+        }
+        reset_format_hits();
+        sam::make_read_groups(rg_ids, sample, library, platform, rgs);
+
+        // write read-group header
+        sam::write_read_groups(out_f, rgs);
+        out_f << "@CO\t" << "QF:" << format << endl;
+
+        // process SAM entries
+        spool_f.rewind();
+        sw.lap(profile::COMPRESS);
+        while (spool_f.getline(line)) {
+            sw.lap(profile::COMPRESS);
+            if (!tag_sam_entry(format, line, rgs, out_f, counts, xy, scratch, sw)) break;
+        }
+    } else {
+        // write read-group header
+        sam::write_read_groups(out_f, rgs);
+        out_f << "@CO\t" << "QF:" << format << endl;
+        sw.groups(rgs.size());
+        
+        // process SAM entries
+        while (true) {
+            if (!tag_sam_entry(format, line, rgs, out_f, counts, xy, scratch, sw)) break;
+
+            // get next line
+            getline(in_f, line);
+            sw.lap(profile::READ);
+            if (line.empty()) break;
+            sw.bytes_in(line.length() + 1);
+        }
+    }
+
+    in_f.close();
+    out_f.close();
 
-        string rg;
-        infer_read_group(format, sam::get_qname_from_core(x.core), rg);
+    if (summary_fname != NULL) {
+        write_rg_summary(summary_fname, *counts, rgs, format);
+    }
+}
+
+/**
+ * Extract reads of selected read-groups using a read-group offset index.
+ *
+ * Only the header and the indexed runs of the selected read-groups are read.
+ */
+bool extract_by_rg(const char* in_fname, const char* index_fname, const set<string>& rgs, const char* out_fname) {
+    rg_index::runs idx;
+    ifstream index_f(index_fname);
+    if (!rg_index::read(index_f, idx)) {
+        cerr << "Error: read-group index " << index_fname << " is malformed" << endl;
+        return false;
+    }
+    index_f.close();
+
+    mapped_file in_f(in_fname);
+    if (!in_f.good()) {
+        cerr << "Error: input file " << in_fname << " is not a seekable file" << endl;
+        return false;
+    }
+    if (in_f.size != idx.size) {
+        cerr << "Error: read-group index does not match input file" << endl;
+        return false;
+    }
 
-        if (rgs.find(rg) == rgs.end()) {
-            cerr << "Warning: read group ID " << rg << " is not found in input read-groups" << endl;
+    // every selected read-group must be indexed
+    set<string> indexed;
+    for (vector<rg_index::run>::const_iterator it = idx.rep.begin(); it != idx.rep.end(); ++it) {
+        indexed.insert(it->rg);
+    }
+    for (set<string>::const_iterator it = rgs.begin(); it != rgs.end(); ++it) {
+        if (indexed.find(*it) == indexed.end()) {
+            cerr << "Error: read group ID " << *it << " is not found in the read-group index" << endl;
+            return false;
         }
-        
-        // tag read with inferred read group
-        sam::replace_opt_field(x.opts, sam::read_group_field(rg));
+    }
 
-        // write modified SAM entry to out file
-        sam::write_raw_entry(out_f, x);
+    ofstream out_f(out_fname);
+    profile::stopwatch sw;
 
-        // get next line
-        getline(in_f, line);
-        if (line.empty()) break;
+    // copy header verbatim
+    out_f.write(in_f.data, idx.header_end());
+    sw.bytes_in(idx.header_end());
+    sw.bytes_out(idx.header_end());
+
+    // copy runs of selected read-groups
+    for (vector<rg_index::run>::const_iterator it = idx.rep.begin(); it != idx.rep.end(); ++it) {
+        if (rgs.find(it->rg) != rgs.end()) {
+            out_f.write(in_f.data + it->begin, it->end - it->begin);
+            sw.bytes_in(it->end - it->begin);
+            sw.bytes_out(it->end - it->begin);
+        }
     }
+    sw.lap(profile::WRITE);
 
-    in_f.close();
     out_f.close();
+    if (out_f.fail()) {
+        cerr << "Error: could not write output file " << out_fname << endl;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Open the cluster coordinate file given by `--coords`.
+ */
+bool open_coords(const option::Option& opt, const char* format, coords::writer& xy) {
+    if (!coords::supported(format)) {
+        cerr << "Error: cluster coordinates cannot be read from read names of format `" << format << "`" << endl;
+        return false;
+    }
+    if (!xy.open(opt.arg) || !file_seekable(opt.arg)) {
+        cerr << "Error: coordinate file " << opt.arg << " must be a writable regular file" << endl;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Read the barcode sheet given by `--barcodes`, allowing the number of
+ * mismatches given by `--mismatches` [default: 1].
+ */
+bool read_barcodes(const option::Option& sheet_opt, const option::Option& mismatches_opt, barcode::sheet& barcodes) {
+    unsigned long k = 1;
+    if (mismatches_opt) {
+        char* end;
+        k = strtoul(mismatches_opt.arg, &end, 10);
+        if (*end != '\0' || end == mismatches_opt.arg || k > 3) {
+            cerr << "Error: number of mismatches must be between 0 and 3" << endl;
+            return false;
+        }
+    }
+    ifstream f(sheet_opt.arg);
+    string error;
+    if (!barcodes.read(f, k, error)) {
+        cerr << "Error: barcode sheet " << sheet_opt.arg << " is malformed: " << error << endl;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Interval between progress reports requested by `--progress`, or 0 if
+ * progress is not to be reported.
+ */
+double progress_interval(const option::Option& opt) {
+    if (!opt) return 0;
+    return opt.arg != NULL ? atof(opt.arg) : 10;
 }
 
 /**
@@ -365,7 +853,7 @@ void tag_sam_with_rg(const char* format, const char* in_fname, const char* rg_fn
  * To split BAM or SAM files with proper read-group information, use instead:
  * samtools view -r <rgid> <in.bam>
  */
-int main(int argc, char* argv[]) {
+int rgsam_main(int argc, char* argv[]) {
 
     argc -= (argc > 0); argv += (argc > 0);  // skip program name if present
 
@@ -375,26 +863,43 @@ int main(int argc, char* argv[]) {
         cerr << "  collect    collect read-group information from SAM or FASTQ file" << endl;
         cerr << "  split      split SAM or FASTQ file based on read-group" << endl;
         cerr << "  tag        tag reads in SAM file with read-group field" << endl;
+        cerr << "  extract    extract reads of read-groups using a read-group index" << endl;
         cout << "  qnames     list supported read name formats" << endl;
         cout << "  version    print version" << endl;
         return 1;
     }
 
+    const char* command = argv[0];
+    bool print_stats = false;
+    const char* metrics_fname = NULL;
+    const char* trace_fname = NULL;
+    metrics::run run(command);
+
     if (strcmp(argv[0], "collect") == 0) {
 
         --argc; ++argv;  // skip command
 
-        enum optionIndex { UNKNOWN, HELP, INPUT, OUTPUT, FORMAT, QNFORMAT, SAMPLE, LIBRARY, PLATFORM };
+        enum optionIndex { UNKNOWN, HELP, INPUT, OUTPUT, FORMAT, QNFORMAT, SAMPLE, LIBRARY, PLATFORM, INDEX, SUMMARY, STATS, PROGRESS, METRICS, TRACE, STRICT, BARCODES, MISMATCHES, COORDS };
         const option::Descriptor usage[] =
         {
           { UNKNOWN, 0, "", "", Arg::None, "usage: rgsam collect [options]\n\noptions:" },
           { INPUT, 0, "i", "input", Arg::InFile,     "  --input     SAM file" },
           { OUTPUT, 0, "o", "output", Arg::OutFile,  "  --output    read-group header file" },
           { FORMAT, 0, "f", "format", Arg::Some,     "  --format    input file format [sam, fastq]" },
-          { QNFORMAT, 0, "q", "qnformat", Arg::Some, "  --qnformat  read name format" },
+          { QNFORMAT, 0, "q", "qnformat", Arg::Some, "  --qnformat  read name format, or comma-separated formats to try in turn" },
           { SAMPLE, 0, "s", "sample", Arg::Some,     "  --sample    sample name" },
           { LIBRARY, 0, "l", "library", Arg::Some,   "  --library   library name" },
           { PLATFORM, 0, "p", "plaform", Arg::Some,  "  --platform  sequencing platform [default: illumina]" },
+          { INDEX, 0, "x", "index", Arg::OutFile,    "  --index     output read-group offset index for `rgsam extract`" },
+          { SUMMARY, 0, "m", "summary", Arg::OutFile, "  --summary   output read-group header and read counts and lengths" },
+          { COORDS, 0, "", "coords", Arg::OutFile,   "  --coords    output binary read-group, tile, x and y of each read" },
+          { BARCODES, 0, "b", "barcodes", Arg::InFile, "  --barcodes  barcode sheet of samples and index sequences, for FASTQ" },
+          { MISMATCHES, 0, "k", "mismatches", Arg::Some, "  --mismatches  mismatches allowed in index sequences [default: 1]" },
+          { STATS, 0, "", "stats", Arg::None,      "  --stats     print processing statistics on exit" },
+          { PROGRESS, 0, "", "progress", Arg::OptionalNumber, "  --progress  report progress every N seconds (--progress=N) [default: 10]" },
+          { METRICS, 0, "", "metrics-json", Arg::OutFile, "  --metrics-json  write processing metrics to a JSON file on exit" },
+          { TRACE, 0, "", "trace", Arg::OutFile,     "  --trace     write stage trace of record batches in Chrome trace format" },
+          { STRICT, 0, "", "strict", Arg::None,      "  --strict    fail on the first warning about a read" },
           { HELP, 0, "h", "help", Arg::None,         "  --help      print usage and exit" },
           { 0, 0, 0, 0, 0, 0 }
         };
@@ -415,6 +920,15 @@ int main(int argc, char* argv[]) {
             return 0;
         }
 
+        print_stats = options[STATS];
+        metrics_fname = options[METRICS].arg;
+        trace_fname = options[TRACE].arg;
+        trace::enabled = options[TRACE];
+        diagnostics::strict = options[STRICT];
+        if (options[STATS] || options[PROGRESS] || options[METRICS] || options[TRACE]) {
+            profile::start();
+        }
+
         const char* qnformat;
         if (options[QNFORMAT].arg == NULL) {
             cerr << "Warning: read name format is not specified; assume `illumina-1.8`" << endl;
@@ -438,13 +952,13 @@ int main(int argc, char* argv[]) {
             output = options[OUTPUT].arg;
         }
 
+        string stem;
         const char* sample = options[SAMPLE].arg;
         if (sample == NULL) {
             if (options[INPUT].arg == NULL) {
                 cerr << "Error: sample name must be specified if input name is not specified" << endl;
                 return 1;
             }
-            string stem;
             get_file_stem(options[INPUT].arg, stem);
             sample = stem.c_str();
         }
@@ -461,15 +975,37 @@ int main(int argc, char* argv[]) {
             platform = options[PLATFORM].arg;
         }
 
+        barcode::sheet barcodes;
+        if (options[BARCODES] && !read_barcodes(options[BARCODES], options[MISMATCHES], barcodes)) {
+            return 1;
+        }
+
+        coords::writer xy;
+        if (options[COORDS] && !open_coords(options[COORDS], qnformat, xy)) {
+            return 1;
+        }
+
         enum file_format::Format format = file_format::get(options[FORMAT].arg, options[INPUT].arg);
+        if (format == file_format::SAM && options[BARCODES]) {
+            cerr << "Warning: index sequences are only read from FASTQ read names; ignore `--barcodes`" << endl;
+        }
+        run.qnformat = qnformat;
+        run.input_format = file_format::name(format);
+        run.input = input;
+        summary::rg_counts* counts = (options[SUMMARY] || options[METRICS]) ? &run.counts : NULL;
+        progress::reporter reporter(progress_interval(options[PROGRESS]), file_size(input));
         switch (format) {
             case file_format::SAM:
-                collect_rg_from_sam(qnformat, input, sample, library, platform, output);
+                collect_rg_from_sam(qnformat, input, sample, library, platform, output, options[INDEX].arg, options[SUMMARY].arg, counts, options[COORDS] ? &xy : NULL);
                 break;
             case file_format::FASTQ:
-                collect_rg_from_fq(qnformat, input, sample, library, platform, output);
+                collect_rg_from_fq(qnformat, input, sample, library, platform, output, options[INDEX].arg, options[SUMMARY].arg, counts, options[BARCODES] ? &barcodes : NULL, options[COORDS] ? &xy : NULL);
                 break;
         }
+        if (options[COORDS] && !xy.close()) {
+            cerr << "Error: could not write coordinate file " << options[COORDS].arg << endl;
+            return 1;
+        }
 
     } else if (strcmp(argv[0], "split") == 0) {
 
@@ -478,17 +1014,27 @@ int main(int argc, char* argv[]) {
         // TODO this command would be more practical if compression is
         // possible on output file
         
-        enum optionIndex { UNKNOWN, HELP, INPUT, OUTPUT, FORMAT, QNFORMAT, SAMPLE, LIBRARY, PLATFORM };
+        enum optionIndex { UNKNOWN, HELP, INPUT, OUTPUT, FORMAT, QNFORMAT, SAMPLE, LIBRARY, PLATFORM, TAG, SUMMARY, STATS, PROGRESS, METRICS, TRACE, STRICT, BARCODES, MISMATCHES, KEY };
         const option::Descriptor usage[] =
         {
           { UNKNOWN, 0, "", "", Arg::None, "usage: rgsam split [options]\n\noptions:" },
           { INPUT, 0, "i", "input", Arg::InFile,     "  --input     SAM file" },
           { OUTPUT, 0, "o", "output", Arg::OutFile,  "  --output    read-group header file" },
           { FORMAT, 0, "f", "format", Arg::Some,     "  --format    input file format [sam, fastq]" },
-          { QNFORMAT, 0, "q", "qnformat", Arg::Some, "  --qnformat  read name format" },
+          { QNFORMAT, 0, "q", "qnformat", Arg::Some, "  --qnformat  read name format, or comma-separated formats to try in turn" },
           { SAMPLE, 0, "s", "sample", Arg::Some,     "  --sample    sample name" },
           { LIBRARY, 0, "l", "library", Arg::Some,   "  --library   library name" },
           { PLATFORM, 0, "p", "plaform", Arg::Some,  "  --platform  sequencing platform [default: illumina]" },
+          { TAG, 0, "t", "tag", Arg::None,           "  --tag       tag reads and write @RG header line in SAM outputs" },
+          { KEY, 0, "", "key", Arg::Some,            "  --key       split by read name fields [flowcell, lane, tile, x, y, index], e.g. lane,tile" },
+          { SUMMARY, 0, "m", "summary", Arg::OutFile, "  --summary   output read-group header and read counts and lengths" },
+          { BARCODES, 0, "b", "barcodes", Arg::InFile, "  --barcodes  barcode sheet of samples and index sequences, for FASTQ" },
+          { MISMATCHES, 0, "k", "mismatches", Arg::Some, "  --mismatches  mismatches allowed in index sequences [default: 1]" },
+          { STATS, 0, "", "stats", Arg::None,      "  --stats     print processing statistics on exit" },
+          { PROGRESS, 0, "", "progress", Arg::OptionalNumber, "  --progress  report progress every N seconds (--progress=N) [default: 10]" },
+          { METRICS, 0, "", "metrics-json", Arg::OutFile, "  --metrics-json  write processing metrics to a JSON file on exit" },
+          { TRACE, 0, "", "trace", Arg::OutFile,     "  --trace     write stage trace of record batches in Chrome trace format" },
+          { STRICT, 0, "", "strict", Arg::None,      "  --strict    fail on the first warning about a read" },
           { HELP, 0, "h", "help", Arg::None,         "  --help      print usage and exit" },
           { 0, 0, 0, 0, 0, 0 }
         };
@@ -509,6 +1055,15 @@ int main(int argc, char* argv[]) {
             return 0;
         }
 
+        print_stats = options[STATS];
+        metrics_fname = options[METRICS].arg;
+        trace_fname = options[TRACE].arg;
+        trace::enabled = options[TRACE];
+        diagnostics::strict = options[STRICT];
+        if (options[STATS] || options[PROGRESS] || options[METRICS] || options[TRACE]) {
+            profile::start();
+        }
+
         const char* qnformat;
         if (options[QNFORMAT].arg == NULL) {
             cerr << "Warning: read name format is not specified; assume `illumina-1.8`" << endl;
@@ -532,13 +1087,13 @@ int main(int argc, char* argv[]) {
             output = options[OUTPUT].arg;
         }
 
+        string stem;
         const char* sample = options[SAMPLE].arg;
         if (sample == NULL) {
             if (options[INPUT].arg == NULL) {
                 cerr << "Error: sample name must be specified if input name is not specified" << endl;
                 return 1;
             }
-            string stem;
             get_file_stem(options[INPUT].arg, stem);
             sample = stem.c_str();
         }
@@ -555,13 +1110,43 @@ int main(int argc, char* argv[]) {
             platform = options[PLATFORM].arg;
         }
 
+        barcode::sheet barcodes;
+        if (options[BARCODES] && !read_barcodes(options[BARCODES], options[MISMATCHES], barcodes)) {
+            return 1;
+        }
+
         enum file_format::Format format = file_format::get(options[FORMAT].arg, options[INPUT].arg);
+
+        key::spec k;
+        if (options[KEY]) {
+            string error;
+            if (!k.parse(options[KEY].arg, error) || !k.check(qnformat, format == file_format::FASTQ, error)) {
+                cerr << "Error: invalid key `" << options[KEY].arg << "`: " << error << endl;
+                return 1;
+            }
+            if (options[TAG]) {
+                cerr << "Error: outputs split by `--key` may hold several read-groups and cannot be tagged; run `rgsam tag` first" << endl;
+                return 1;
+            }
+        }
+
+        if (format == file_format::SAM && options[BARCODES]) {
+            cerr << "Warning: index sequences are only read from FASTQ read names; ignore `--barcodes`" << endl;
+        }
+        run.qnformat = qnformat;
+        run.input_format = file_format::name(format);
+        run.input = input;
+        summary::rg_counts* counts = (options[SUMMARY] || options[METRICS]) ? &run.counts : NULL;
+        progress::reporter reporter(progress_interval(options[PROGRESS]), file_size(input));
         switch (format) {
             case file_format::SAM:
-                split_sam_by_rg(qnformat, input, sample, library, platform, output);
+                split_sam_by_rg(qnformat, input, sample, library, platform, output, options[TAG], options[SUMMARY].arg, counts, options[KEY] ? &k : NULL);
                 break;
             case file_format::FASTQ:
-                split_fq_by_rg(qnformat, input, sample, library, platform, output);
+                if (options[TAG]) {
+                    cerr << "Warning: FASTQ reads cannot be tagged; ignore `--tag`" << endl;
+                }
+                split_fq_by_rg(qnformat, input, sample, library, platform, output, options[SUMMARY].arg, counts, options[BARCODES] ? &barcodes : NULL, options[KEY] ? &k : NULL);
                 break;
         }
 
@@ -569,14 +1154,24 @@ int main(int argc, char* argv[]) {
 
         --argc; ++argv;  // skip command
 
-        enum optionIndex { UNKNOWN, HELP, INPUT, INPUT_RG, OUTPUT, QNFORMAT };
+        enum optionIndex { UNKNOWN, HELP, INPUT, INPUT_RG, OUTPUT, QNFORMAT, SAMPLE, LIBRARY, PLATFORM, SUMMARY, STATS, PROGRESS, METRICS, TRACE, STRICT, COORDS };
         const option::Descriptor usage[] =
         {
             { UNKNOWN, 0, "", "", Arg::None, "usage: rgsam tag [options]\n\noptions:" },
             { INPUT, 0, "i", "input", Arg::InFile,     "  --input     input SAM file" },
-            { INPUT_RG, 0, "r", "rg", Arg::InFile,     "  --rg        input read-group header file" },
+            { INPUT_RG, 0, "r", "rg", Arg::InFile,     "  --rg        input read-group header file [default: collect from input]" },
             { OUTPUT, 0, "o", "output", Arg::OutFile,  "  --output    output SAM file" },
-            { QNFORMAT, 0, "q", "qnformat", Arg::Some, "  --qnformat  read name format" },
+            { QNFORMAT, 0, "q", "qnformat", Arg::Some, "  --qnformat  read name format, or comma-separated formats to try in turn" },
+            { SAMPLE, 0, "s", "sample", Arg::Some,     "  --sample    sample name (without --rg)" },
+            { LIBRARY, 0, "l", "library", Arg::Some,   "  --library   library name (without --rg)" },
+            { PLATFORM, 0, "p", "plaform", Arg::Some,  "  --platform  sequencing platform (without --rg) [default: illumina]" },
+            { SUMMARY, 0, "m", "summary", Arg::OutFile, "  --summary   output read-group header and read counts and lengths" },
+            { COORDS, 0, "", "coords", Arg::OutFile,   "  --coords    output binary read-group, tile, x and y of each read" },
+            { STATS, 0, "", "stats", Arg::None,      "  --stats     print processing statistics on exit" },
+            { PROGRESS, 0, "", "progress", Arg::OptionalNumber, "  --progress  report progress every N seconds (--progress=N) [default: 10]" },
+            { METRICS, 0, "", "metrics-json", Arg::OutFile, "  --metrics-json  write processing metrics to a JSON file on exit" },
+            { TRACE, 0, "", "trace", Arg::OutFile,     "  --trace     write stage trace of record batches in Chrome trace format" },
+            { STRICT, 0, "", "strict", Arg::None,      "  --strict    fail on the first warning about a read" },
             { HELP, 0, "h", "help", Arg::None,         "  --help      print usage and exit" },
             { 0, 0, 0, 0, 0, 0 }
         };
@@ -597,6 +1192,15 @@ int main(int argc, char* argv[]) {
             return 0;
         }
 
+        print_stats = options[STATS];
+        metrics_fname = options[METRICS].arg;
+        trace_fname = options[TRACE].arg;
+        trace::enabled = options[TRACE];
+        diagnostics::strict = options[STRICT];
+        if (options[STATS] || options[PROGRESS] || options[METRICS] || options[TRACE]) {
+            profile::start();
+        }
+
         const char* qnformat;
         if (options[QNFORMAT].arg == NULL) {
             cerr << "Warning: read name format is not specified; assume `illumina-1.8`" << endl;
@@ -613,9 +1217,115 @@ int main(int argc, char* argv[]) {
         }
 
         const char* input_rg = options[INPUT_RG].arg;
-        if (input_rg == NULL) {
-            cerr << "Error: read-group header file is required and can be"
-                    "acquired by running `rgsam collect`" << endl;
+
+        string stem;
+        const char* sample = options[SAMPLE].arg;
+        if (sample == NULL && input_rg == NULL) {
+            if (options[INPUT].arg == NULL) {
+                cerr << "Error: sample name must be specified if neither input name nor read-group header file is specified" << endl;
+                return 1;
+            }
+            get_file_stem(options[INPUT].arg, stem);
+            sample = stem.c_str();
+        }
+        
+        const char* library = options[LIBRARY].arg;
+        if (library == NULL) {
+            library = sample;
+        }
+
+        const char* platform;
+        if (options[PLATFORM].arg == NULL) {
+            platform = "illumina";
+        } else {
+            platform = options[PLATFORM].arg;
+        }
+
+        const char* output;
+        if (options[OUTPUT].arg == NULL || strcmp(options[OUTPUT].arg, "-") == 0) {
+            cerr << "Info: writing to stdout" << endl;
+            output = "/dev/stdout";
+        } else {
+            output = options[OUTPUT].arg;
+        }
+
+        coords::writer xy;
+        if (options[COORDS] && !open_coords(options[COORDS], qnformat, xy)) {
+            return 1;
+        }
+
+        // without a read-group header file, a seekable input is read twice
+        int passes = (input_rg == NULL && file_seekable(input)) ? 2 : 1;
+        run.qnformat = qnformat;
+        run.input_format = file_format::name(file_format::SAM);
+        run.input = input;
+        summary::rg_counts* counts = (options[SUMMARY] || options[METRICS]) ? &run.counts : NULL;
+        progress::reporter reporter(progress_interval(options[PROGRESS]), file_size(input) * passes);
+        tag_sam_with_rg(qnformat, input, input_rg, sample, library, platform, output, options[SUMMARY].arg, counts, options[COORDS] ? &xy : NULL);
+        if (options[COORDS] && !xy.close()) {
+            cerr << "Error: could not write coordinate file " << options[COORDS].arg << endl;
+            return 1;
+        }
+
+    } else if (strcmp(argv[0], "extract") == 0) {
+
+        --argc; ++argv;  // skip command
+
+        enum optionIndex { UNKNOWN, HELP, INPUT, INDEX, GROUP, OUTPUT, STATS, METRICS };
+        const option::Descriptor usage[] =
+        {
+            { UNKNOWN, 0, "", "", Arg::None, "usage: rgsam extract [options]\n\noptions:" },
+            { INPUT, 0, "i", "input", Arg::InFile,     "  --input     input SAM or FASTQ file (seekable)" },
+            { INDEX, 0, "x", "index", Arg::InFile,     "  --index     read-group offset index from `rgsam collect`" },
+            { GROUP, 0, "g", "group", Arg::Some,       "  --group     read-group ID to extract (repeatable)" },
+            { OUTPUT, 0, "o", "output", Arg::OutFile,  "  --output    output file" },
+            { STATS, 0, "", "stats", Arg::None,      "  --stats     print processing statistics on exit" },
+            { METRICS, 0, "", "metrics-json", Arg::OutFile, "  --metrics-json  write processing metrics to a JSON file on exit" },
+            { HELP, 0, "h", "help", Arg::None,         "  --help      print usage and exit" },
+            { 0, 0, 0, 0, 0, 0 }
+        };
+
+        option::Stats stats(usage, argc, argv);
+        option::Option options[stats.options_max], buffer[stats.buffer_max];
+        option::Parser parse(usage, argc, argv, options, buffer);
+
+        if (parse.error()) return 1;
+
+        if (argc == 0) {
+            option::printUsage(cerr, usage);
+            return 1;
+        }
+
+        if (options[HELP]) {
+            option::printUsage(cerr, usage);
+            return 0;
+        }
+
+        print_stats = options[STATS];
+        metrics_fname = options[METRICS].arg;
+        if (options[STATS] || options[METRICS]) {
+            profile::start();
+        }
+
+        const char* input = options[INPUT].arg;
+        if (input == NULL || strcmp(input, "-") == 0) {
+            cerr << "Error: input file is required and must be seekable" << endl;
+            return 1;
+        }
+
+        const char* index = options[INDEX].arg;
+        if (index == NULL) {
+            cerr << "Error: read-group index is required and can be "
+                    "acquired by running `rgsam collect --index`" << endl;
+            return 1;
+        }
+
+        set<string> groups;
+        for (option::Option* opt = options[GROUP]; opt != NULL; opt = opt->next()) {
+            groups.insert(opt->arg);
+        }
+        if (groups.empty()) {
+            cerr << "Error: at least one read-group must be specified" << endl;
             return 1;
         }
 
@@ -627,7 +1337,8 @@ int main(int argc, char* argv[]) {
             output = options[OUTPUT].arg;
         }
 
-        tag_sam_with_rg(qnformat, input, input_rg, output);
+        run.input = input;
+        if (!extract_by_rg(input, index, groups, output)) return 1;
 
     } else if (strcmp(argv[0], "qnames") == 0) {
 
@@ -645,6 +1356,22 @@ int main(int argc, char* argv[]) {
              << "  \"broad-1.0\": {" << endl
              << "    \"format\": \"@{flowcell,5}:{barcode}:{lane}:{tile}:{x}:{y}\"," << endl
              << "    \"example\": \"@H0164ALXX140820:2:1101:10003:23460\"" << endl
+             << "  }," << endl
+             << "  \"mgi\": {" << endl
+             << "    \"format\": \"@{flowcell,10}L{lane}C{column,3}R{row,3}{read}/{pair}\"," << endl
+             << "    \"example\": \"@V300012345L1C001R0010000001/1\"" << endl
+             << "  }," << endl
+             << "  \"ont\": {" << endl
+             << "    \"format\": \"@{read} runid={run} ... flow_cell_id={flowcell} ...\"," << endl
+             << "    \"example\": \"@0f3a6bd2-6ac1-4ad4-b6e8-7e0b1e1a5c52 runid=7c3a5e0f2d ch=42 start_time=2021-03-01T10:00:00Z flow_cell_id=FAQ12345\"" << endl
+             << "  }," << endl
+             << "  \"pacbio\": {" << endl
+             << "    \"format\": \"@{movie}/{zmw}/{ccs or start_end}\"," << endl
+             << "    \"example\": \"@m64011_190830_220126/1/ccs\"" << endl
+             << "  }," << endl
+             << "  \"sra\": {" << endl
+             << "    \"format\": \"@{accession}.{read} {illumina-1.8 or illumina-1.0 name} ...\"," << endl
+             << "    \"example\": \"@SRR1234567.1 EAS139:136:FC706VJ:2:2104:15343:197393 length=101\"" << endl
              << "  }" << endl
              << "}" << endl;
 
@@ -659,6 +1386,33 @@ int main(int argc, char* argv[]) {
 
     }
 
+    diagnostics::report(cerr);
+    report_format_hits(cerr);
+
+    if (print_stats) {
+        profile::report(cerr, command);
+    }
+
+    if (trace_fname != NULL) {
+        ofstream trace_f(trace_fname);
+        profile::write_trace(trace_f);
+        trace_f.close();
+    }
+
+    if (metrics_fname != NULL) {
+        ofstream metrics_f(metrics_fname);
+        metrics::write(metrics_f, run);
+        metrics_f.close();
+    }
+
     return 0;
 }
 
+int main(int argc, char* argv[]) {
+    try {
+        return rgsam_main(argc, argv);
+    } catch (const exception& e) {
+        cerr << "Error: " << e.what() << endl;
+        return 1;
+    }
+}
@@ -0,0 +1,53 @@
+#ifndef _RGSAM_ALLOC_HPP_
+#define _RGSAM_ALLOC_HPP_
+
+#include <new>
+#include <cstdlib>
+#include <atomic>
+
+/**
+ * Counting hooks for global operator new and delete.
+ *
+ * The hooks are only compiled into allocation profiling builds, which define
+ * `RGSAM_COUNT_ALLOCS` (see `make bin/rgsam-alloc`); they add an atomic
+ * increment to every allocation. Including this header then replaces the
+ * global allocation functions of the program, so it must be included by
+ * exactly one translation unit.
+ */
+
+namespace alloc {
+
+#ifdef RGSAM_COUNT_ALLOCS
+const bool counting = true;
+#else
+const bool counting = false;
+#endif
+
+/// number of allocations
+std::atomic<unsigned long long> count(0);
+/// number of bytes allocated
+std::atomic<unsigned long long> bytes(0);
+
+}  // namespace alloc
+
+#ifdef RGSAM_COUNT_ALLOCS
+
+void* operator new(size_t n) {
+    alloc::count.fetch_add(1, std::memory_order_relaxed);
+    alloc::bytes.fetch_add(n, std::memory_order_relaxed);
+    void* p = std::malloc(n == 0 ? 1 : n);
+    if (p == NULL) throw std::bad_alloc();
+    return p;
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    std::free(p);
+}
+
+#endif  // RGSAM_COUNT_ALLOCS
+
+#endif  // _RGSAM_ALLOC_HPP_
@@ -3,6 +3,7 @@
 
 #include <iostream>
 #include <cstring>
+#include <cstdlib>
 
 #include "optionparser.hpp"
 #include "file.hpp"
@@ -15,6 +16,18 @@ struct Arg: public option::Arg
         return option::ARG_ILLEGAL;
     }
 
+    /**
+     * Optional positive number, which must be attached (e.g. `--opt=2.5`).
+     */
+    static option::ArgStatus OptionalNumber(const option::Option& option, bool msg) {
+        if (option.arg == NULL) return option::ARG_IGNORE;
+        char* end;
+        double x = std::strtod(option.arg, &end);
+        if (end != option.arg && *end == '\0' && x > 0) return option::ARG_OK;
+        if (msg) std::cerr << "Error: option `" << option.name << "` requires a positive number" << std::endl;
+        return option::ARG_ILLEGAL;
+    }
+
     static option::ArgStatus InFile(const option::Option& option, bool msg) {
         if (option.arg != NULL) {
             if (std::strcmp(option.arg, "-") == 0 || file_exists(option.arg)) {
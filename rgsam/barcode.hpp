@@ -0,0 +1,243 @@
+#ifndef _RGSAM_BARCODE_HPP_
+#define _RGSAM_BARCODE_HPP_
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <cstdlib>
+
+#include <stdint.h>
+
+#include "string.hpp"
+#include "sam.hpp"
+
+namespace barcode {
+
+/// longest index sequence (including a `+` between dual indices)
+const size_t max_length = 21;
+
+/// name given to reads whose index matches no sample
+const char* undetermined = "undetermined";
+
+/**
+ * Code of an index sequence character, or 0 if it is not allowed.
+ */
+inline unsigned code(char c) {
+    switch (c) {
+        case 'A': case 'a': return 1;
+        case 'C': case 'c': return 2;
+        case 'G': case 'g': return 3;
+        case 'T': case 't': return 4;
+        case 'N': case 'n': return 5;
+        case '+': return 6;
+        default: return 0;
+    }
+}
+
+/**
+ * Pack an index sequence into an integer key, 3 bits per character below a
+ * leading 1 bit, so that sequences of different lengths differ.
+ */
+inline bool encode(const char* s, size_t n, uint64_t& key) {
+    if (n == 0 || n > max_length) return false;
+    key = 1;
+    for (size_t i = 0; i < n; ++i) {
+        unsigned c = code(s[i]);
+        if (c == 0) return false;
+        key = key << 3 | c;
+    }
+    return true;
+}
+
+/**
+ * Find the index sequence (or sample number) in a read name.
+ *
+ * It is the last field of the comment of an Illumina 1.8 or 2.17 read name
+ * (`... 1:N:0:ATCACG`), or the field after `#` of an Illumina 1.4 read name
+ * (`...#ATCACG/1`).
+ */
+inline bool find_index(const std::string& qname, size_t& pos, size_t& len) {
+    size_t space = qname.find(' ');
+    size_t end;
+    if (space != std::string::npos) {
+        end = qname.find_first_of(" \t", space + 1);
+        if (end == std::string::npos) end = qname.length();
+        pos = qname.rfind(':', end - 1);
+        if (pos == std::string::npos || pos < space) return false;
+        ++pos;
+    } else {
+        pos = qname.find('#');
+        if (pos == std::string::npos) return false;
+        ++pos;
+        end = qname.find('/', pos);
+        if (end == std::string::npos) end = qname.length();
+    }
+    len = end - pos;
+    return len > 0;
+}
+
+/**
+ * Barcode sheet: samples and their index sequences.
+ *
+ * Every sequence within `k` mismatches of an index is precomputed into a
+ * hash table, so a read is assigned to its sample with a single probe.
+ * Mismatches are substitutions, including by `N`. A sequence that is equally
+ * close to the indices of two samples is ambiguous and matches neither.
+ */
+class sheet {
+public:
+    sheet() : k(0) {}
+
+    /**
+     * Read a sheet of `<sample> <index> [<library>]` lines, separated by tabs
+     * or spaces.
+     *
+     * Lines starting with `#` are comments. Dual indices are written as
+     * `<index1>+<index2>`, as in read names.
+     */
+    bool read(std::istream& f, size_t mismatches, std::string& error) {
+        k = mismatches;
+        std::string line;
+        size_t line_no = 0;
+        while (std::getline(f, line)) {
+            ++line_no;
+            if (line.empty() || line[0] == '#') continue;
+            size_t sep = line.find_first_of(" \t");
+            size_t start = sep == std::string::npos ? sep : line.find_first_not_of(" \t", sep);
+            if (start == std::string::npos) {
+                error = "line " + std::to_string(line_no) + " has no index sequence";
+                return false;
+            }
+            size_t end = line.find_first_of(" \t\r", start);
+            if (end == std::string::npos) end = line.length();
+            std::string index = line.substr(start, end - start);
+            to_upper(index);
+            uint64_t key;
+            if (!encode(index.data(), index.length(), key)) {
+                error = "line " + std::to_string(line_no) + " has an invalid index sequence " + index;
+                return false;
+            }
+            samples.push_back(line.substr(0, sep));
+            size_t lib_start = line.find_first_not_of(" \t\r", end);
+            if (lib_start == std::string::npos) {
+                libraries.push_back(std::string());
+            } else {
+                size_t lib_end = line.find_first_of(" \t\r", lib_start);
+                libraries.push_back(line.substr(lib_start, lib_end == std::string::npos ? lib_end : lib_end - lib_start));
+            }
+            add_neighbours(index, samples.size() - 1, 0, 0);
+        }
+        if (samples.empty()) {
+            error = "no samples are given";
+            return false;
+        }
+        return true;
+    }
+
+    /**
+     * Row of the sample of an index sequence, or -1 if it matches none.
+     *
+     * A sequence of digits is taken to be a 1-based sample number, as written
+     * by bcl2fastq 2.17 and later.
+     */
+    int find(const char* s, size_t n) const {
+        if (s[0] >= '0' && s[0] <= '9') {
+            char* end;
+            unsigned long x = std::strtoul(s, &end, 10);
+            if (end != s + n || x == 0 || x > samples.size()) return -1;
+            return x - 1;
+        }
+        uint64_t key;
+        if (!encode(s, n, key)) return -1;
+        std::unordered_map<uint64_t, match>::const_iterator it = table.find(key);
+        if (it == table.end()) return -1;
+        return it->second.sample;
+    }
+
+    /**
+     * Append `_<sample>` to a read-group, with the sample of the index in the
+     * read name, or `_undetermined`.
+     *
+     * @return row of the sample, or -1 if it is undetermined
+     */
+    int append_sample(const std::string& qname, std::string& rg) const {
+        size_t pos, len;
+        int s = -1;
+        if (find_index(qname, pos, len)) {
+            s = find(qname.data() + pos, len);
+        }
+        rg += '_';
+        if (s >= 0) {
+            rg += samples[s];
+        } else {
+            rg += undetermined;
+        }
+        return s;
+    }
+
+    /**
+     * Create the header line of a read-group of the sample in row `s`, with
+     * the sample name and (if given) the library of the sheet. Undetermined
+     * reads (`s` < 0) keep the given sample and library.
+     */
+    std::string read_group_line(const std::string& rg, int s, const char* sample,
+            const char* library, const char* platform) const {
+        if (s < 0) return sam::read_group_line(rg, sample, library, platform);
+        const std::string& lib = libraries[s];
+        return sam::read_group_line(rg, samples[s].c_str(), lib.empty() ? library : lib.c_str(), platform);
+    }
+
+    std::vector<std::string> samples;
+    /// library of each sample, or empty if not given
+    std::vector<std::string> libraries;
+
+private:
+    struct match {
+        /// sample, or -1 if ambiguous
+        int sample;
+        size_t mismatches;
+    };
+
+    /**
+     * Add `seq` and every sequence with up to `k - d` further substitutions
+     * at positions from `from`.
+     */
+    void add_neighbours(std::string& seq, int sample, size_t from, size_t d) {
+        add(seq, sample, d);
+        if (d == k) return;
+        static const char bases[] = "ACGTN";
+        for (size_t i = from; i < seq.length(); ++i) {
+            char c = seq[i];
+            if (c == '+') continue;
+            for (const char* b = bases; *b != '\0'; ++b) {
+                if (*b == c) continue;
+                seq[i] = *b;
+                add_neighbours(seq, sample, i + 1, d + 1);
+            }
+            seq[i] = c;
+        }
+    }
+
+    void add(const std::string& seq, int sample, size_t d) {
+        uint64_t key;
+        encode(seq.data(), seq.length(), key);
+        std::unordered_map<uint64_t, match>::iterator it = table.find(key);
+        if (it == table.end()) {
+            match m = { sample, d };
+            table[key] = m;
+        } else if (d < it->second.mismatches) {
+            it->second.sample = sample;
+            it->second.mismatches = d;
+        } else if (d == it->second.mismatches && it->second.sample != sample) {
+            it->second.sample = -1;
+        }
+    }
+
+    size_t k;
+    std::unordered_map<uint64_t, match> table;
+};
+
+}  // namespace barcode
+
+#endif  // _RGSAM_BARCODE_HPP_
@@ -0,0 +1,170 @@
+#ifndef _RGSAM_COORDS_HPP_
+#define _RGSAM_COORDS_HPP_
+
+#include <string>
+#include <vector>
+#include <map>
+#include <fstream>
+#include <cstring>
+#include <stdint.h>
+
+#include "qname.hpp"
+
+/**
+ * Binary sidecar of cluster coordinates, one row per record in input order.
+ *
+ * The file is laid out for memory mapping, in native (little-endian) byte
+ * order:
+ *
+ *   header  40 bytes   magic "RGSAMXY\0", version, row size, number of rows,
+ *                      offset of read-group names, number of read-groups
+ *   rows    16 bytes   read-group number, tile, x, y; all uint32
+ *   names              read-group IDs, each terminated by '\0', numbered
+ *                      from 0 in order of first appearance
+ *
+ * A field missing from a read name is stored as `coords::missing`.
+ */
+
+namespace coords {
+
+const char magic[8] = { 'R', 'G', 'S', 'A', 'M', 'X', 'Y', '\0' };
+
+const uint32_t version = 1;
+
+/// value of a field missing from a read name
+const uint32_t missing = 0xffffffff;
+
+struct header {
+    char magic[8];
+    uint32_t version;
+    uint32_t row_size;
+    uint64_t n_rows;
+    uint64_t names_offset;
+    uint64_t n_groups;
+};
+
+struct row {
+    uint32_t rg;
+    uint32_t tile;
+    uint32_t x;
+    uint32_t y;
+};
+
+/**
+ * Whether coordinates can be read from read names of a format.
+ */
+inline bool supported(const char* format) {
+    return has_qname_field(format, qname_fields::TILE) && has_qname_field(format, qname_fields::X)
+        && has_qname_field(format, qname_fields::Y);
+}
+
+/**
+ * Parse the decimal field of a read name at `r`, or return `missing`.
+ */
+inline uint32_t parse_field(const std::string& qname, const qname_fields::range& r) {
+    if (r.start == std::string::npos || r.end == r.start || r.end - r.start > 9) return missing;
+    uint32_t v = 0;
+    for (size_t i = r.start; i < r.end; ++i) {
+        char c = qname[i];
+        if (c < '0' || c > '9') return missing;
+        v = v * 10 + (c - '0');
+    }
+    return v;
+}
+
+/**
+ * Writes a coordinate sidecar as records are processed.
+ *
+ * Rows are buffered and written in blocks; the header is rewritten with the
+ * final counts on close, so the output must be a seekable file.
+ */
+class writer {
+public:
+    writer() : n_rows(0), last_id(0), has_last(false) {}
+
+    bool open(const char* fname) {
+        f.open(fname, std::ios::binary);
+        if (!f.good()) return false;
+        write_header(0);
+        return f.good();
+    }
+
+    /**
+     * Add the row of a record with read-group `rg` and read name `qname`,
+     * given the positions of its fields found by read-group inference.
+     */
+    void add(const std::string& qname, const qname_fields::range* fields, const std::string& rg) {
+        row x;
+        x.rg = id(rg);
+        x.tile = parse_field(qname, fields[qname_fields::TILE]);
+        x.x = parse_field(qname, fields[qname_fields::X]);
+        x.y = parse_field(qname, fields[qname_fields::Y]);
+        rows.push_back(x);
+        ++n_rows;
+        if (rows.size() == block_size) flush();
+    }
+
+    /**
+     * Write the read-group names and the final header.
+     */
+    bool close() {
+        flush();
+        uint64_t names_offset = sizeof(header) + n_rows * sizeof(row);
+        for (std::vector<const std::string*>::const_iterator it = names.begin(); it != names.end(); ++it) {
+            f.write((*it)->c_str(), (*it)->length() + 1);
+        }
+        f.seekp(0);
+        write_header(names_offset);
+        f.close();
+        return !f.fail();
+    }
+
+private:
+    static const size_t block_size = 4096;
+
+    /**
+     * Number of a read-group; reads of one read-group are usually adjacent,
+     * so the last one is checked first.
+     */
+    uint32_t id(const std::string& rg) {
+        if (has_last && *names[last_id] == rg) return last_id;
+        std::map<std::string, uint32_t>::iterator it = ids.find(rg);
+        if (it == ids.end()) {
+            it = ids.insert(std::make_pair(rg, static_cast<uint32_t>(names.size()))).first;
+            names.push_back(&it->first);
+        }
+        last_id = it->second;
+        has_last = true;
+        return last_id;
+    }
+
+    void flush() {
+        if (rows.empty()) return;
+        f.write(reinterpret_cast<const char*>(&rows[0]), rows.size() * sizeof(row));
+        rows.clear();
+    }
+
+    void write_header(uint64_t names_offset) {
+        header h;
+        memcpy(h.magic, magic, sizeof(magic));
+        h.version = version;
+        h.row_size = sizeof(row);
+        h.n_rows = n_rows;
+        h.names_offset = names_offset;
+        h.n_groups = names.size();
+        f.write(reinterpret_cast<const char*>(&h), sizeof(h));
+    }
+
+    std::ofstream f;
+    std::vector<row> rows;
+    uint64_t n_rows;
+    std::map<std::string, uint32_t> ids;
+    /// read-group IDs by number, pointing to the keys of `ids`
+    std::vector<const std::string*> names;
+    uint32_t last_id;
+    bool has_last;
+};
+
+}  // namespace coords
+
+#endif  // _RGSAM_COORDS_HPP_
@@ -0,0 +1,117 @@
+#ifndef _RGSAM_DIAGNOSTICS_HPP_
+#define _RGSAM_DIAGNOSTICS_HPP_
+
+#include <iostream>
+#include <string>
+#include <map>
+#include <stdexcept>
+
+/**
+ * Warnings about individual reads, counted by kind and read-group.
+ *
+ * Only the first few warnings of each kind are printed as they occur; the
+ * rest are counted and summarized by `report` at exit, so that a bad input
+ * does not flood the log with one line per read. In strict mode, the first
+ * warning is raised as a `failure` instead.
+ */
+
+namespace diagnostics {
+
+enum kind {
+    UNMATCHED_QNAME,
+    UNKNOWN_READ_GROUP,
+    MISSING_TAG,
+    MISSING_KEY_FIELD,
+    n_kinds
+};
+
+/// description of the reads of each kind, for the summary
+const char* kind_summaries[n_kinds] = {
+    "reads whose names do not match the read name format",
+    "reads whose read-groups are not found in input read-groups",
+    "reads without the optional field of their read-group",
+    "reads without a field of the key"
+};
+
+/// number of warnings of each kind that are printed as they occur
+const unsigned long long max_samples = 5;
+
+/// number of read-groups listed per kind in the summary
+const size_t max_listed = 10;
+
+/// whether the first warning is raised as a failure
+bool strict = false;
+
+class failure : public std::runtime_error {
+public:
+    failure(const std::string& what) : std::runtime_error(what) {}
+};
+
+/**
+ * Count of warnings of one kind.
+ */
+struct tally {
+    unsigned long long total;
+    std::map<std::string, unsigned long long> by_rg;
+
+    tally() : total(0) {}
+};
+
+tally tallies[n_kinds];
+
+std::string message(kind k, const std::string& rg, const std::string& qname) {
+    switch (k) {
+        case UNMATCHED_QNAME:
+            return "read name " + qname + " does not match the read name format";
+        case UNKNOWN_READ_GROUP:
+            return "read group ID " + rg + " is not found in input read-groups";
+        case MISSING_TAG:
+            return "read " + qname + " has no optional field of its read-group";
+        case MISSING_KEY_FIELD:
+            return "read name " + qname + " has no field of the key";
+        default:
+            return "unknown warning";
+    }
+}
+
+/**
+ * Warn about a read with read name `qname` and inferred read-group `rg`.
+ */
+void warn(kind k, const std::string& rg, const std::string& qname) {
+    if (strict) throw failure(message(k, rg, qname) + " (--strict)");
+
+    tally& t = tallies[k];
+    ++t.total;
+    if (!rg.empty()) ++t.by_rg[rg];
+
+    if (t.total <= max_samples) {
+        std::cerr << "Warning: " << message(k, rg, qname) << '\n';
+        if (t.total == max_samples) {
+            std::cerr << "Info: further warnings of this kind are summarized on exit" << '\n';
+        }
+    }
+}
+
+/**
+ * Print a summary of the warnings of each kind.
+ */
+void report(std::ostream& f) {
+    for (int k = 0; k < n_kinds; ++k) {
+        const tally& t = tallies[k];
+        if (t.total == 0) continue;
+        f << "Warning: " << t.total << ' ' << kind_summaries[k];
+        size_t i = 0;
+        std::map<std::string, unsigned long long>::const_iterator it;
+        for (it = t.by_rg.begin(); it != t.by_rg.end() && i < max_listed; ++it, ++i) {
+            f << (i == 0 ? ": " : ", ") << it->first << " (" << it->second << ')';
+        }
+        if (it != t.by_rg.end()) {
+            f << ", and " << t.by_rg.size() - i << " more read-groups";
+        }
+        f << std::endl;
+    }
+}
+
+}  // namespace diagnostics
+
+#endif  // _RGSAM_DIAGNOSTICS_HPP_
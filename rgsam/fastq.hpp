@@ -17,6 +17,8 @@ struct entry {
     string qname;
     /// read sequence
     string seq;
+    /// separator line: `+`, optionally followed by the read name again
+    string plus;
     /// read quality scores
     string qual;
 };
@@ -25,6 +27,8 @@ struct entry {
  * Read one fastq entry from file.
  *
  * Assume that each sequence and each quality score entry is single-line.
+ * Lines may be of any length (e.g. multi-megabase Nanopore reads); reading
+ * into the same entry reuses its storage once it has grown to fit.
  */
 bool read_entry(istream& f, entry& x) {
     getline(f, x.qname);
@@ -32,9 +36,8 @@ bool read_entry(istream& f, entry& x) {
     
     getline(f, x.seq);
 
-    string marker;
-    getline(f, marker);
-    if (marker != "+") {
+    getline(f, x.plus);
+    if (x.plus.empty() || x.plus[0] != '+') {
         throw runtime_error("fastq entry is malformed");
     }
 
@@ -43,13 +46,22 @@ bool read_entry(istream& f, entry& x) {
     return true;
 }
 
+/**
+ * Number of bytes that a fastq entry occupies in file.
+ *
+ * Assume that every line, including the last, ends with a newline.
+ */
+size_t entry_size(const entry& x) {
+    return x.qname.length() + x.seq.length() + x.plus.length() + x.qual.length() + 4;
+}
+
 /** 
  * Write one fastq entry to file.
  */
 void write_entry(ostream& f, const entry& x) {
     f << x.qname << endl;
     f << x.seq << endl;
-    f << '+' << endl;
+    f << x.plus << endl;
     f << x.qual << endl;
 }
 
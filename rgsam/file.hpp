@@ -4,6 +4,12 @@
 #include <fstream>
 #include <string>
 
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+
 inline bool file_exists (const char* fname) {
     std::ifstream f(fname);
     return f.good();
@@ -14,6 +20,66 @@ inline bool file_writable (const char* fname) {
     return f.good();
 }
 
+/**
+ * Check whether a file is a regular file that can be read more than once.
+ */
+inline bool file_seekable (const char* fname) {
+    struct stat st;
+    return stat(fname, &st) == 0 && S_ISREG(st.st_mode);
+}
+
+/**
+ * Size of a regular file in bytes, or 0 if the file is not regular.
+ */
+inline unsigned long long file_size (const char* fname) {
+    struct stat st;
+    if (stat(fname, &st) != 0 || !S_ISREG(st.st_mode)) return 0;
+    return st.st_size;
+}
+
+/**
+ * Read-only memory map of a whole file.
+ */
+class mapped_file {
+public:
+    mapped_file(const char* fname) : data(NULL), size(0), mapped(false) {
+        int fd = open(fname, O_RDONLY);
+        if (fd < 0) return;
+        struct stat st;
+        if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode)) {
+            size = st.st_size;
+            if (size == 0) {
+                mapped = true;
+            } else {
+                void* p = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+                if (p != MAP_FAILED) {
+                    madvise(p, size, MADV_SEQUENTIAL);
+                    data = static_cast<const char*>(p);
+                    mapped = true;
+                }
+            }
+        }
+        close(fd);
+    }
+
+    ~mapped_file() {
+        if (data != NULL) munmap(const_cast<char*>(data), size);
+    }
+
+    bool good() const {
+        return mapped;
+    }
+
+    const char* data;
+    size_t size;
+
+private:
+    bool mapped;
+
+    mapped_file(const mapped_file&);
+    mapped_file& operator=(const mapped_file&);
+};
+
 /**
  * Get file stem.
  *
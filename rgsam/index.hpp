@@ -0,0 +1,104 @@
+#ifndef _RGSAM_INDEX_HPP_
+#define _RGSAM_INDEX_HPP_
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+
+namespace rg_index {
+
+using namespace std;
+
+/**
+ * Contiguous run of records from one read-group.
+ */
+struct run {
+    /// read-group ID
+    string rg;
+    /// byte offset of the first record
+    unsigned long long begin;
+    /// byte offset past the last record
+    unsigned long long end;
+
+    run(const string& _rg, unsigned long long _begin, unsigned long long _end)
+    : rg(_rg), begin(_begin), end(_end) {}
+};
+
+/**
+ * Read-group offset index of a file.
+ *
+ * Records are listed as runs in file order; adjacent records from the same
+ * read-group share one run, so sorted input yields one run per read-group.
+ */
+struct runs {
+    vector<run> rep;
+    /// size of the indexed file
+    unsigned long long size;
+
+    runs() : size(0) {}
+
+    /**
+     * Add the record spanning [begin, end) to the index.
+     */
+    void add(const string& rg, unsigned long long begin, unsigned long long end) {
+        if (!rep.empty() && rep.back().end == begin && rep.back().rg == rg) {
+            rep.back().end = end;
+        } else {
+            rep.push_back(run(rg, begin, end));
+        }
+    }
+
+    /**
+     * Offset of the first record; anything before it is header.
+     */
+    unsigned long long header_end() const {
+        return rep.empty() ? size : rep.front().begin;
+    }
+};
+
+const char* magic = "#rgsam-index";
+
+/**
+ * Write index.
+ *
+ * The first line holds the size of the indexed file, and each subsequent 
+ * line holds one run as `<rg>\t<begin>\t<end>`.
+ */
+void write(ostream& f, const runs& x) {
+    f << magic << '\t' << x.size << endl;
+    for (vector<run>::const_iterator it = x.rep.begin(); it != x.rep.end(); ++it) {
+        f << it->rg << '\t' << it->begin << '\t' << it->end << '\n';
+    }
+}
+
+/**
+ * Read index.
+ *
+ * Every run must lie within the indexed file and after the header.
+ */
+bool read(istream& f, runs& x) {
+    string line;
+    getline(f, line);
+    istringstream head(line);
+    string tag;
+    if (!(head >> tag >> x.size) || tag != magic) return false;
+
+    while (getline(f, line)) {
+        if (line.empty()) break;
+        size_t end = line.find('\t');
+        if (end == string::npos) return false;
+        istringstream offsets(line.substr(end + 1));
+        unsigned long long begin_offset, end_offset;
+        if (!(offsets >> begin_offset >> end_offset)) return false;
+        if (begin_offset > end_offset || end_offset > x.size) return false;
+        if (!x.rep.empty() && begin_offset < x.header_end()) return false;
+        x.rep.push_back(run(line.substr(0, end), begin_offset, end_offset));
+    }
+
+    return true;
+}
+
+}  // namespace rg_index
+
+#endif  // _RGSAM_INDEX_HPP_
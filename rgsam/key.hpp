@@ -0,0 +1,98 @@
+#ifndef _RGSAM_KEY_HPP_
+#define _RGSAM_KEY_HPP_
+
+#include <string>
+#include <vector>
+#include <cstring>
+
+#include "qname.hpp"
+#include "barcode.hpp"
+
+/**
+ * Partition keys made of named read name fields, e.g. `lane,tile`.
+ *
+ * The fields of a read name are located by read-group inference, in the same
+ * scan, and the values of the chosen fields are joined by `_` in the order
+ * given.
+ */
+
+namespace key {
+
+const char* field_names[qname_fields::n_fields] = {
+    "flowcell", "lane", "tile", "x", "y", "index"
+};
+
+/**
+ * Key of comma-separated field names.
+ */
+class spec {
+public:
+    /**
+     * Parse field names, e.g. `lane,tile`.
+     */
+    bool parse(const char* x, std::string& error) {
+        fields.clear();
+        const char* p = x;
+        while (true) {
+            const char* comma = strchr(p, ',');
+            std::string name = comma == NULL ? std::string(p) : std::string(p, comma);
+            int i = 0;
+            while (i < qname_fields::n_fields && name != field_names[i]) ++i;
+            if (i == qname_fields::n_fields) {
+                error = "unknown field `" + name + "`";
+                return false;
+            }
+            fields.push_back(static_cast<qname_fields::field>(i));
+            if (comma == NULL) break;
+            p = comma + 1;
+        }
+        return true;
+    }
+
+    /**
+     * Check that every field can be found in read names of a format, in FASTQ
+     * input if `fastq` and in SAM input otherwise.
+     */
+    bool check(const char* format, bool fastq, std::string& error) const {
+        for (size_t i = 0; i < fields.size(); ++i) {
+            if (!has_qname_field(format, fields[i]) || (fields[i] == qname_fields::INDEX && !fastq)) {
+                error = std::string("field `") + field_names[fields[i]] + "` is not found in "
+                    + (fastq ? "FASTQ" : "SAM") + " read names of format `" + format + "`";
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /**
+     * Set `out` to the key of a read name, given the positions of its fields
+     * found by read-group inference, reusing its storage; `out` is left empty
+     * if a field is not found.
+     */
+    void make(const std::string& qname, const qname_fields::range* ranges, std::string& out) const {
+        out.clear();
+        for (size_t i = 0; i < fields.size(); ++i) {
+            size_t start = ranges[fields[i]].start, end = ranges[fields[i]].end;
+            if (fields[i] == qname_fields::INDEX) {
+                size_t len;
+                if (barcode::find_index(qname, start, len)) {
+                    end = start + len;
+                } else {
+                    start = std::string::npos;
+                }
+            }
+            if (start == std::string::npos || end == start) {
+                out.clear();
+                return;
+            }
+            if (i > 0) out += '_';
+            out.append(qname, start, end - start);
+        }
+    }
+
+    std::vector<qname_fields::field> fields;
+};
+
+}  // namespace key
+
+#endif  // _RGSAM_KEY_HPP_
@@ -0,0 +1,140 @@
+#ifndef _RGSAM_METRICS_HPP_
+#define _RGSAM_METRICS_HPP_
+
+#include <iostream>
+#include <cstdio>
+
+#include "summary.hpp"
+#include "profile.hpp"
+#include "qname.hpp"
+
+/**
+ * Machine-readable processing metrics, written as one JSON object.
+ */
+
+namespace metrics {
+
+/**
+ * Description of one command run.
+ */
+struct run {
+    const char* command;
+    const char* qnformat;
+    const char* input_format;
+    const char* input;
+    /// reads and bases of each read-group seen
+    summary::rg_counts counts;
+
+    run(const char* command)
+        : command(command), qnformat(NULL), input_format(NULL), input(NULL) {}
+};
+
+/**
+ * Write a JSON string, or `null` if `x` is NULL.
+ */
+void write_string(std::ostream& f, const char* x) {
+    if (x == NULL) {
+        f << "null";
+        return;
+    }
+    f << '"';
+    for (const char* p = x; *p != '\0'; ++p) {
+        unsigned char c = *p;
+        if (c == '"' || c == '\\') {
+            f << '\\' << c;
+        } else if (c < 0x20) {
+            char buf[8];
+            snprintf(buf, sizeof(buf), "\\u%04x", c);
+            f << buf;
+        } else {
+            f << c;
+        }
+    }
+    f << '"';
+}
+
+void write_number(std::ostream& f, double x) {
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%.6g", x);
+    f << buf;
+}
+
+/**
+ * Write the reads matched by each format of a format list, or null if no
+ * list is in use.
+ */
+void write_format_hits(std::ostream& f, const format_list& x) {
+    if (x.spec == NULL) {
+        f << "null";
+        return;
+    }
+    f << "{";
+    for (size_t i = 0; i < x.formats.size(); ++i) {
+        f << (i == 0 ? " " : ", ");
+        write_string(f, x.formats[i].c_str());
+        f << ": " << x.hits[i];
+    }
+    f << " }";
+}
+
+/**
+ * Write the metrics of a run, with the statistics collected by `profile`.
+ */
+void write(std::ostream& f, const run& r) {
+    profile::measures m = profile::measure();
+    const profile::totals& x = m.x;
+
+    f << "{" << std::endl;
+    f << "  \"command\": "; write_string(f, r.command); f << "," << std::endl;
+    f << "  \"qnformat\": "; write_string(f, r.qnformat); f << "," << std::endl;
+    f << "  \"qnformat_hits\": ";
+    write_format_hits(f, formats_tried);
+    f << "," << std::endl;
+    f << "  \"input_format\": "; write_string(f, r.input_format); f << "," << std::endl;
+    f << "  \"input\": "; write_string(f, r.input); f << "," << std::endl;
+    f << "  \"records\": " << x.records << "," << std::endl;
+    f << "  \"bytes_in\": " << x.bytes_in << "," << std::endl;
+    f << "  \"bytes_out\": " << x.bytes_out << "," << std::endl;
+    f << "  \"wall_seconds\": "; write_number(f, m.wall); f << "," << std::endl;
+    f << "  \"user_seconds\": "; write_number(f, m.user); f << "," << std::endl;
+    f << "  \"sys_seconds\": "; write_number(f, m.sys); f << "," << std::endl;
+    f << "  \"peak_rss_kb\": " << m.peak_rss_kb << "," << std::endl;
+
+    double wall = m.wall > 0 ? m.wall : 1;
+    f << "  \"throughput\": {" << std::endl;
+    f << "    \"mb_per_s_in\": "; write_number(f, x.bytes_in / wall * 1e-6); f << "," << std::endl;
+    f << "    \"mb_per_s_out\": "; write_number(f, x.bytes_out / wall * 1e-6); f << "," << std::endl;
+    f << "    \"records_per_s\": "; write_number(f, x.records / wall); f << std::endl;
+    f << "  }," << std::endl;
+
+    f << "  \"stage_seconds\": {" << std::endl;
+    for (int i = 0; i < profile::n_stages; ++i) {
+        f << "    \"" << profile::stage_names[i] << "\": ";
+        write_number(f, m.stage_seconds[i]);
+        f << (i + 1 < profile::n_stages ? "," : "") << std::endl;
+    }
+    f << "  }," << std::endl;
+
+    // only counted in allocation profiling builds
+    if (alloc::counting) {
+        f << "  \"allocations\": " << m.n_allocs << "," << std::endl;
+        f << "  \"allocated_bytes\": " << m.n_alloc_bytes << "," << std::endl;
+    } else {
+        f << "  \"allocations\": null," << std::endl;
+        f << "  \"allocated_bytes\": null," << std::endl;
+    }
+
+    f << "  \"read_groups\": [";
+    for (summary::rg_counts::const_iterator it = r.counts.begin(); it != r.counts.end(); ++it) {
+        f << (it == r.counts.begin() ? "" : ",") << std::endl;
+        f << "    { \"id\": "; write_string(f, it->first.c_str());
+        f << ", \"reads\": " << it->second.reads
+          << ", \"bases\": " << it->second.bases << " }";
+    }
+    f << (r.counts.empty() ? "]" : "\n  ]") << std::endl;
+    f << "}" << std::endl;
+}
+
+}  // namespace metrics
+
+#endif  // _RGSAM_METRICS_HPP_
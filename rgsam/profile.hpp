@@ -0,0 +1,350 @@
+#ifndef _RGSAM_PROFILE_HPP_
+#define _RGSAM_PROFILE_HPP_
+
+#include <iostream>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <cstdio>
+
+#include <time.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+
+#include "alloc.hpp"
+#include "trace.hpp"
+
+/**
+ * Processing statistics: record and byte counters, and time spent per stage.
+ *
+ * Counters are kept per thread and summed when reported. Stage times are
+ * taken with the time-stamp counter where available, which costs a few
+ * nanoseconds per reading, and converted to seconds against the monotonic
+ * clock when reported.
+ *
+ * Record, byte and read-group counters may be read by other threads while
+ * they are updated (e.g. for progress reports). Each has a single writer, so
+ * updates are relaxed loads and stores that cost no more than plain ones.
+ */
+
+namespace profile {
+
+enum stage {
+    READ,
+    PARSE,
+    INFER,
+    REWRITE,
+    COMPRESS,
+    WRITE,
+    n_stages
+};
+
+const char* stage_names[n_stages] = {
+    "read", "parse", "infer", "rewrite", "compress", "write"
+};
+
+/// whether statistics are collected
+bool enabled = false;
+
+inline unsigned long long now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/**
+ * Read a cheap, monotonically increasing tick counter.
+ */
+inline unsigned long long ticks() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __builtin_ia32_rdtsc();
+#else
+    return now_ns();
+#endif
+}
+
+typedef std::atomic<unsigned long long> shared_counter;
+
+/**
+ * Add to a counter that has only one writer.
+ */
+inline void bump(shared_counter& x, unsigned long long n) {
+    x.store(x.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+
+/**
+ * Counters of one thread.
+ */
+struct counters {
+    shared_counter records;
+    shared_counter bytes_in;
+    shared_counter bytes_out;
+    /// read-groups seen so far
+    shared_counter groups;
+    /// owned by the thread; read only once it is done
+    unsigned long long stage_ticks[n_stages];
+
+    counters() : records(0), bytes_in(0), bytes_out(0), groups(0) {
+        for (int i = 0; i < n_stages; ++i) stage_ticks[i] = 0;
+    }
+};
+
+/**
+ * Snapshot of counters summed over threads.
+ */
+struct totals {
+    unsigned long long records;
+    unsigned long long bytes_in;
+    unsigned long long bytes_out;
+    unsigned long long groups;
+    unsigned long long stage_ticks[n_stages];
+
+    totals() : records(0), bytes_in(0), bytes_out(0), groups(0) {
+        for (int i = 0; i < n_stages; ++i) stage_ticks[i] = 0;
+    }
+
+    void add(const counters& x) {
+        records += x.records.load(std::memory_order_relaxed);
+        bytes_in += x.bytes_in.load(std::memory_order_relaxed);
+        bytes_out += x.bytes_out.load(std::memory_order_relaxed);
+        groups += x.groups.load(std::memory_order_relaxed);
+        for (int i = 0; i < n_stages; ++i) stage_ticks[i] += x.stage_ticks[i];
+    }
+};
+
+/**
+ * Counters of all threads, and the clocks at which collection started.
+ */
+struct registry {
+    std::mutex lock;
+    std::vector<counters*> threads;
+    unsigned long long start_ns;
+    unsigned long long start_ticks;
+
+    registry() : start_ns(now_ns()), start_ticks(ticks()) {}
+
+    ~registry() {
+        for (size_t i = 0; i < threads.size(); ++i) delete threads[i];
+    }
+
+    counters* add() {
+        std::lock_guard<std::mutex> guard(lock);
+        threads.push_back(new counters());
+        return threads.back();
+    }
+
+    totals total() {
+        std::lock_guard<std::mutex> guard(lock);
+        totals x;
+        for (size_t i = 0; i < threads.size(); ++i) x.add(*threads[i]);
+        return x;
+    }
+};
+
+registry all;
+
+/**
+ * Counters of the calling thread.
+ */
+inline counters& local() {
+    static thread_local counters* x = all.add();
+    return *x;
+}
+
+/**
+ * Start collecting statistics.
+ */
+void start() {
+    enabled = true;
+    all.start_ns = now_ns();
+    all.start_ticks = ticks();
+}
+
+/**
+ * Attributes elapsed time to stages in turn, and counts records and bytes.
+ *
+ * Each call to `lap` charges the time since the previous lap (or since
+ * construction) to the given stage. All calls are no-ops unless statistics
+ * are enabled. If tracing is enabled too, stage times are also recorded per
+ * batch of records.
+ */
+class stopwatch {
+public:
+    stopwatch()
+        : c(enabled ? &local() : NULL), last(c != NULL ? ticks() : 0),
+          b(c != NULL && trace::enabled ? &trace::local() : NULL) {
+        start_batch();
+    }
+
+    ~stopwatch() {
+        if (b != NULL) end_batch();
+    }
+
+    void lap(stage s) {
+        if (c == NULL) return;
+        unsigned long long t = ticks();
+        c->stage_ticks[s] += t - last;
+        if (b != NULL) batch_ticks[s] += t - last;
+        last = t;
+    }
+
+    void record() {
+        if (c == NULL) return;
+        bump(c->records, 1);
+        if (b != NULL && ++batch_records == trace::batch_size) {
+            end_batch();
+            start_batch();
+        }
+    }
+
+    void bytes_in(size_t n) {
+        if (c != NULL) bump(c->bytes_in, n);
+    }
+
+    void bytes_out(size_t n) {
+        if (c != NULL) bump(c->bytes_out, n);
+    }
+
+    /**
+     * Count the bytes of an entry read, as given by its `entry_size`.
+     */
+    template <class entry>
+    void entry_in(const entry& x) {
+        if (c != NULL) bump(c->bytes_in, entry_size(x));
+    }
+
+    /**
+     * Count the bytes of an entry written, as given by its `entry_size`.
+     */
+    template <class entry>
+    void entry_out(const entry& x) {
+        if (c != NULL) bump(c->bytes_out, entry_size(x));
+    }
+
+    /**
+     * Set the number of read-groups seen so far.
+     */
+    void groups(size_t n) {
+        if (c != NULL) c->groups.store(n, std::memory_order_relaxed);
+    }
+
+private:
+    void start_batch() {
+        batch_begin = last;
+        batch_records = 0;
+        for (int i = 0; i < n_stages; ++i) batch_ticks[i] = 0;
+    }
+
+    /**
+     * Record the batch, with its stages laid end to end.
+     */
+    void end_batch() {
+        if (last == batch_begin) return;
+        b->add("batch", batch_begin, last - batch_begin, batch_records);
+        unsigned long long t = batch_begin;
+        for (int i = 0; i < n_stages; ++i) {
+            if (batch_ticks[i] == 0) continue;
+            b->add(stage_names[i], t, batch_ticks[i], 0);
+            t += batch_ticks[i];
+        }
+    }
+
+    counters* c;
+    unsigned long long last;
+
+    trace::buffer* b;
+    unsigned long long batch_begin;
+    unsigned long batch_records;
+    unsigned long long batch_ticks[n_stages];
+};
+
+/**
+ * Seconds per tick, calibrated against the monotonic clock since start.
+ */
+double seconds_per_tick() {
+    unsigned long long ns = now_ns() - all.start_ns;
+    unsigned long long t = ticks() - all.start_ticks;
+    return t > 0 ? ns * 1e-9 / t : 0.0;
+}
+
+/**
+ * Write the trace events recorded since start.
+ */
+void write_trace(std::ostream& f) {
+    trace::write(f, all.start_ticks, seconds_per_tick());
+}
+
+double timeval_seconds(const struct timeval& x) {
+    return x.tv_sec + x.tv_usec * 1e-6;
+}
+
+/**
+ * Statistics of the process so far.
+ */
+struct measures {
+    totals x;
+    double wall;
+    double user;
+    double sys;
+    long peak_rss_kb;
+    double stage_seconds[n_stages];
+    unsigned long long n_allocs;
+    unsigned long long n_alloc_bytes;
+};
+
+measures measure() {
+    measures m;
+    m.x = all.total();
+    m.wall = (now_ns() - all.start_ns) * 1e-9;
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    m.user = timeval_seconds(usage.ru_utime);
+    m.sys = timeval_seconds(usage.ru_stime);
+    m.peak_rss_kb = usage.ru_maxrss;
+
+    double spt = seconds_per_tick();
+    for (int i = 0; i < n_stages; ++i) m.stage_seconds[i] = m.x.stage_ticks[i] * spt;
+
+    m.n_allocs = alloc::count.load(std::memory_order_relaxed);
+    m.n_alloc_bytes = alloc::bytes.load(std::memory_order_relaxed);
+    return m;
+}
+
+/**
+ * Print statistics.
+ */
+void report(std::ostream& f, const char* command) {
+    measures m = measure();
+    const totals& x = m.x;
+    double wall = m.wall;
+
+    char buf[256];
+    f << "Stats: command " << command << std::endl;
+    snprintf(buf, sizeof(buf), "records %llu, bytes in %llu, bytes out %llu",
+            x.records, x.bytes_in, x.bytes_out);
+    f << "Stats: " << buf << std::endl;
+    snprintf(buf, sizeof(buf), "wall %.3f s, user %.3f s, sys %.3f s, peak RSS %ld kB",
+            wall, m.user, m.sys, m.peak_rss_kb);
+    f << "Stats: " << buf << std::endl;
+    if (wall > 0) {
+        snprintf(buf, sizeof(buf), "throughput %.1f MB/s in, %.1f MB/s out, %.0f records/s",
+                x.bytes_in / wall * 1e-6, x.bytes_out / wall * 1e-6, x.records / wall);
+        f << "Stats: " << buf << std::endl;
+    }
+    for (int i = 0; i < n_stages; ++i) {
+        double seconds = m.stage_seconds[i];
+        snprintf(buf, sizeof(buf), "stage %-8s %.3f s (%.1f%%)",
+                stage_names[i], seconds, wall > 0 ? seconds / wall * 100 : 0.0);
+        f << "Stats: " << buf << std::endl;
+    }
+    if (alloc::counting) {
+        snprintf(buf, sizeof(buf), "allocations %llu (%.2f per record), %llu bytes",
+                m.n_allocs, x.records > 0 ? (double) m.n_allocs / x.records : 0.0, m.n_alloc_bytes);
+        f << "Stats: " << buf << std::endl;
+    }
+}
+
+}  // namespace profile
+
+#endif  // _RGSAM_PROFILE_HPP_
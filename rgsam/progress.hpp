@@ -0,0 +1,106 @@
+#ifndef _RGSAM_PROGRESS_HPP_
+#define _RGSAM_PROGRESS_HPP_
+
+#include <iostream>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <cstdio>
+
+#include "profile.hpp"
+
+/**
+ * Live progress reports on a timer thread.
+ *
+ * The reporter only reads the profile counters, which the processing threads
+ * update with relaxed stores; it takes no locks that they would contend on.
+ */
+
+namespace progress {
+
+/**
+ * Format seconds as h:mm:ss.
+ */
+void format_duration(double seconds, char* buf, size_t n) {
+    unsigned long s = seconds > 0 ? (unsigned long) (seconds + 0.5) : 0;
+    snprintf(buf, n, "%lu:%02lu:%02lu", s / 3600, s / 60 % 60, s % 60);
+}
+
+/**
+ * Print one progress line.
+ *
+ * `total` is the number of input bytes expected, or 0 if it is unknown.
+ * Rates are over the interval since the previous report.
+ */
+void report(std::ostream& f, const profile::totals& x, const profile::totals& prev, double elapsed, double interval, unsigned long long total) {
+    char buf[256];
+    int n = snprintf(buf, sizeof(buf), "%llu records, %.1f MB", x.records, x.bytes_in * 1e-6);
+    if (total > 0 && n < (int) sizeof(buf)) {
+        n += snprintf(buf + n, sizeof(buf) - n, " of %.1f MB (%.1f%%)",
+                total * 1e-6, x.bytes_in * 100.0 / total);
+    }
+    if (interval > 0 && n < (int) sizeof(buf)) {
+        n += snprintf(buf + n, sizeof(buf) - n, ", %.0f records/s, %.1f MB/s",
+                (x.records - prev.records) / interval, (x.bytes_in - prev.bytes_in) / interval * 1e-6);
+    }
+    if (total > 0 && x.bytes_in > 0 && x.bytes_in < total && n < (int) sizeof(buf)) {
+        // estimate from the average rate so far, which fluctuates less
+        char eta[32];
+        format_duration(elapsed * (total - x.bytes_in) / x.bytes_in, eta, sizeof(eta));
+        n += snprintf(buf + n, sizeof(buf) - n, ", ETA %s", eta);
+    }
+    if (n < (int) sizeof(buf)) {
+        snprintf(buf + n, sizeof(buf) - n, ", %llu read-groups", x.groups);
+    }
+    f << "Progress: " << buf << std::endl;
+}
+
+/**
+ * Reports progress every `interval` seconds until destroyed.
+ *
+ * No reports are made if `interval` is not positive.
+ */
+class reporter {
+public:
+    reporter(double interval, unsigned long long total)
+        : interval(interval), total(total), done(false) {
+        if (interval > 0) thread = std::thread(&reporter::run, this);
+    }
+
+    ~reporter() {
+        if (!thread.joinable()) return;
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            done = true;
+        }
+        wake.notify_one();
+        thread.join();
+    }
+
+private:
+    void run() {
+        profile::totals prev;
+        unsigned long long start = profile::now_ns();
+        unsigned long long last = start;
+        std::unique_lock<std::mutex> guard(lock);
+        while (!wake.wait_for(guard, std::chrono::duration<double>(interval), [this] { return done; })) {
+            profile::totals x = profile::all.total();
+            unsigned long long now = profile::now_ns();
+            report(std::cerr, x, prev, (now - start) * 1e-9, (now - last) * 1e-9, total);
+            prev = x;
+            last = now;
+        }
+    }
+
+    double interval;
+    unsigned long long total;
+    bool done;
+    std::mutex lock;
+    std::condition_variable wake;
+    std::thread thread;
+};
+
+}  // namespace progress
+
+#endif  // _RGSAM_PROGRESS_HPP_
@@ -0,0 +1,522 @@
+#ifndef _RGSAM_QNAME_HPP_
+#define _RGSAM_QNAME_HPP_
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <stdexcept>
+#include <cstring>
+#include <cctype>
+#include <algorithm>
+
+#include "string.hpp"
+
+/**
+ * Positions of the fields of a read name, as found by read-group inference.
+ */
+namespace qname_fields {
+
+enum field {
+    FLOWCELL,
+    LANE,
+    TILE,
+    X,
+    Y,
+    INDEX,
+    n_fields
+};
+
+/**
+ * Range of a field in a read name; `start` is npos if it is not found.
+ */
+struct range {
+    size_t start;
+    size_t end;
+};
+
+inline void clear(range* fields) {
+    for (int i = 0; i < n_fields; ++i) fields[i].start = fields[i].end = std::string::npos;
+}
+
+inline void set(range* fields, field f, size_t start, size_t end) {
+    fields[f].start = start;
+    fields[f].end = end;
+}
+
+/**
+ * Find tile, x and y as the `:`-separated fields after the lane, which ends
+ * at `lane_end`; y ends at one of `y_stops` or at the end of the name.
+ */
+inline void find_tile_x_y(const std::string& qname, size_t lane_end, const char* y_stops, range* fields) {
+    size_t name_end = std::min(qname.find_first_of(" \t", lane_end), qname.length());
+    size_t tile_end = qname.find(':', lane_end + 1);
+    if (tile_end >= name_end) return;
+    size_t x_end = qname.find(':', tile_end + 1);
+    if (x_end >= name_end) return;
+    size_t y_end = std::min(qname.find_first_of(y_stops, x_end + 1), name_end);
+    set(fields, TILE, lane_end + 1, tile_end);
+    set(fields, X, tile_end + 1, x_end);
+    set(fields, Y, x_end + 1, y_end);
+}
+
+}  // namespace qname_fields
+
+/**
+ * Set read-group to `{flowcell}_{lane}` from the given ranges of the read
+ * name, reusing the storage of `rg`.
+ */
+inline void make_read_group(const std::string& qname, size_t flowcell_start, size_t flowcell_end,
+        size_t lane_start, size_t lane_end, std::string& rg) {
+    rg.assign(qname, flowcell_start, flowcell_end - flowcell_start);
+    rg += '_';
+    rg.append(qname, lane_start, lane_end - lane_start);
+}
+
+/**
+ * Infer read-group based on flowcell id and lane id,
+ * assuming Illumina v1.0 read name format.
+ *
+ * The read-group is left empty if the read name does not match the format.
+ * If `fields` is given, it receives the positions of the fields found.
+ */
+void infer_read_group_illumina10(const std::string& qname, std::string& rg, qname_fields::range* fields = NULL) {
+    rg.clear();
+
+    // extract flowcell
+    size_t flowcell_end = find_in_string(qname, '-', 0, 1);
+    if (flowcell_end == std::string::npos) return;
+
+    // extract lane
+    size_t start = find_in_string(qname, ':', flowcell_end + 1, 1);
+    if (start == std::string::npos) return;
+    ++start;
+    size_t end = find_in_string(qname, ':', start, 1);
+    if (end == std::string::npos) return;
+
+    // only tile, x and y follow, unlike in Illumina v1.8 read names
+    size_t extra = find_in_string(qname, ':', end, 3);
+    if (extra != std::string::npos && extra < qname.find(' ', end)) return;
+
+    make_read_group(qname, 0, flowcell_end, start, end, rg);
+
+    if (fields != NULL) {
+        qname_fields::set(fields, qname_fields::FLOWCELL, 0, flowcell_end);
+        qname_fields::set(fields, qname_fields::LANE, start, end);
+        qname_fields::find_tile_x_y(qname, end, "#/", fields);
+    }
+}
+
+/**
+ * Infer read-group based on flowcell id and lane id,
+ * assuming Illumina v1.8 read name format.
+ *
+ * The read-group is left empty if the read name does not match the format.
+ * If `fields` is given, it receives the positions of the fields found.
+ */
+void infer_read_group_illumina18(const std::string& qname, std::string& rg, qname_fields::range* fields = NULL) {
+    rg.clear();
+
+    // extract flowcell
+    size_t flowcell_start = find_in_string(qname, ':', 0, 2);
+    if (flowcell_start == std::string::npos) return;
+    ++flowcell_start;
+    size_t flowcell_end = find_in_string(qname, ':', flowcell_start, 1);
+    if (flowcell_end == std::string::npos) return;
+
+    // extract lane
+    size_t start = flowcell_end + 1;
+    size_t end = find_in_string(qname, ':', start, 1);
+    if (end == std::string::npos) return;
+
+    // tile, x and y follow, unlike in Illumina v1.0 read names
+    if (find_in_string(qname, ':', end, 2) == std::string::npos) return;
+
+    make_read_group(qname, flowcell_start, flowcell_end, start, end, rg);
+
+    if (fields != NULL) {
+        qname_fields::set(fields, qname_fields::FLOWCELL, flowcell_start, flowcell_end);
+        qname_fields::set(fields, qname_fields::LANE, start, end);
+        qname_fields::find_tile_x_y(qname, end, "", fields);
+    }
+}
+
+/**
+ * Infer read-group based on flowcell id and lane id,
+ * assuming Broad v1.0 read name format.
+ *
+ * The read-group is left empty if the read name does not match the format.
+ * If `fields` is given, it receives the positions of the fields found.
+ */
+void infer_read_group_broad10(const std::string& qname, std::string& rg, qname_fields::range* fields = NULL) {
+    rg.clear();
+
+    // extract flowcell
+    size_t flowcell_end = std::min(qname.length(), (size_t) 5);
+
+    // extract lane
+    size_t start = find_in_string(qname, ':', 5, 1);
+    if (start == std::string::npos) return;
+    ++start;
+    size_t end = find_in_string(qname, ':', start, 1);
+    if (end == std::string::npos) return;
+
+    make_read_group(qname, 0, flowcell_end, start, end, rg);
+
+    if (fields != NULL) {
+        qname_fields::set(fields, qname_fields::FLOWCELL, 0, flowcell_end);
+        qname_fields::set(fields, qname_fields::LANE, start, end);
+        qname_fields::find_tile_x_y(qname, end, "", fields);
+    }
+}
+
+/**
+ * Length of the flowcell of an MGI/DNBSEQ read name, or 0 if the name does
+ * not match the format.
+ */
+inline size_t mgi_flowcell_length(const std::string& qname) {
+    if (qname.length() > 13 && qname[10] == 'L' && qname[12] == 'C' && isdigit(static_cast<unsigned char>(qname[11]))) {
+        return 10;
+    } else if (qname.length() > 14 && qname[11] == 'L' && qname[13] == 'C' && isdigit(static_cast<unsigned char>(qname[12]))) {
+        return 11;
+    }
+    return 0;
+}
+
+/**
+ * Infer read-group based on flowcell id and lane id,
+ * assuming MGI/DNBSEQ read name format (`{flowcell}L{lane}C{column}R{row}...`).
+ *
+ * Fields are at fixed offsets, so nothing is scanned: the flowcell is the
+ * first 10 characters (or 11, as on BGISEQ-500), and the layout is checked by
+ * the bytes around the lane.
+ *
+ * The read-group is left empty if the read name does not match the format.
+ * If `fields` is given, it receives the positions of flowcell and lane.
+ */
+void infer_read_group_mgi(const std::string& qname, std::string& rg, qname_fields::range* fields = NULL) {
+    rg.clear();
+
+    // extract flowcell
+    size_t flowcell_end = mgi_flowcell_length(qname);
+    if (flowcell_end == 0) return;
+
+    // extract lane
+    make_read_group(qname, 0, flowcell_end, flowcell_end + 1, flowcell_end + 2, rg);
+
+    if (fields != NULL) {
+        qname_fields::set(fields, qname_fields::FLOWCELL, 0, flowcell_end);
+        qname_fields::set(fields, qname_fields::LANE, flowcell_end + 1, flowcell_end + 2);
+    }
+}
+
+/**
+ * Find the value of a `key=value` field in the comment of a read name.
+ *
+ * `key` includes the `=`. The key is located by a substring search (glibc
+ * `memmem` scans with vector instructions), so the comment is not split into
+ * fields; a match counts only if it starts a field.
+ */
+inline bool find_field_value(const std::string& qname, const char* key, size_t key_len,
+        size_t& pos, size_t& len) {
+    const char* s = qname.data();
+    const char* end = s + qname.length();
+    const char* p = s;
+    while (p < end) {
+        const char* hit = static_cast<const char*>(memmem(p, end - p, key, key_len));
+        if (hit == NULL) return false;
+        if (hit > s && (hit[-1] == ' ' || hit[-1] == '\t')) {
+            const char* value = hit + key_len;
+            const char* value_end = value;
+            while (value_end < end && *value_end != ' ' && *value_end != '\t') ++value_end;
+            pos = value - s;
+            len = value_end - value;
+            return true;
+        }
+        p = hit + 1;
+    }
+    return false;
+}
+
+/**
+ * Infer read-group based on run id, or on flowcell id if there is none,
+ * assuming Oxford Nanopore read name format.
+ *
+ * The read-group is left empty if the read name does not match the format.
+ */
+void infer_read_group_ont(const std::string& qname, std::string& rg) {
+    rg.clear();
+
+    size_t pos, len;
+    if (find_field_value(qname, "runid=", 6, pos, len)
+            || find_field_value(qname, "flow_cell_id=", 13, pos, len)) {
+        rg.assign(qname, pos, len);
+    }
+}
+
+/**
+ * Infer read-group based on movie name, assuming PacBio read name format
+ * (`{movie}/{zmw}/...`).
+ *
+ * Reads of one movie come in long runs, so the movie of the previous read
+ * (per thread) is kept, and a read whose name starts with it followed by `/`
+ * takes it without parsing.
+ *
+ * The read-group is left empty if the read name does not match the format.
+ */
+void infer_read_group_pacbio(const std::string& qname, std::string& rg) {
+    static thread_local std::string last;
+
+    // movie must be followed by the zmw number
+    size_t n = last.length();
+    if (n > 0 && qname.length() > n + 1 && qname[n] == '/' && isdigit(static_cast<unsigned char>(qname[n + 1]))
+            && qname.compare(0, n, last) == 0) {
+        rg.assign(last);
+        return;
+    }
+
+    rg.clear();
+
+    // extract movie
+    if (qname.empty() || qname[0] != 'm') return;
+    size_t end = qname.find('/', 1);
+    if (end == std::string::npos || end + 1 >= qname.length() || !isdigit(static_cast<unsigned char>(qname[end + 1]))) return;
+
+    last.assign(qname, 0, end);
+    rg.assign(last);
+}
+
+void infer_read_group(const char* format, const std::string& qname, std::string& rg);
+
+/**
+ * List of read name formats (e.g. `illumina-1.8,illumina-1.0`), tried in
+ * turn for each read until one matches.
+ */
+struct format_list {
+    /// the list as given
+    const char* spec;
+    std::vector<std::string> formats;
+    /// reads matched by each format
+    std::vector<unsigned long long> hits;
+    /// format that matched last, which is tried first
+    size_t last;
+
+    format_list() : spec(NULL), last(0) {}
+
+    void assign(const char* x) {
+        spec = x;
+        formats.clear();
+        const char* p = x;
+        while (true) {
+            const char* comma = strchr(p, ',');
+            formats.push_back(comma == NULL ? std::string(p) : std::string(p, comma));
+            if (comma == NULL) break;
+            p = comma + 1;
+        }
+        hits.assign(formats.size(), 0);
+        last = 0;
+    }
+};
+
+/**
+ * Infer read-group with the first matching format of a comma-separated list.
+ *
+ * The format that matched the previous read is tried first, so that reads of
+ * one format in a run cost a single attempt each; the others follow in list
+ * order. Matches are counted by format in `x`.
+ */
+void infer_read_group_list(format_list& x, const char* formats, const std::string& qname, std::string& rg) {
+    if (x.spec != formats) x.assign(formats);
+
+    infer_read_group(x.formats[x.last].c_str(), qname, rg);
+    if (!rg.empty()) {
+        ++x.hits[x.last];
+        return;
+    }
+
+    for (size_t i = 0; i < x.formats.size(); ++i) {
+        if (i == x.last) continue;
+        infer_read_group(x.formats[i].c_str(), qname, rg);
+        if (!rg.empty()) {
+            ++x.hits[i];
+            x.last = i;
+            return;
+        }
+    }
+}
+
+/// format list in use, if any
+format_list formats_tried;
+
+/**
+ * Infer read-group with the first matching format of a comma-separated list,
+ * counting matches in `formats_tried`.
+ */
+void infer_read_group_list(const char* formats, const std::string& qname, std::string& rg) {
+    infer_read_group_list(formats_tried, formats, qname, rg);
+}
+
+/// inner formats of plain `sra`, tried in turn
+const char* sra_formats = "illumina-1.8,illumina-1.0";
+
+/**
+ * Infer read-group from the original read name in the comment of an SRA read
+ * name (`{accession}.{read} {original name} ...`), which is parsed in the
+ * given inner format, or the first matching format of a comma-separated list.
+ *
+ * Reads of one run come in long runs, so for Illumina 1.8 original names, the
+ * start of the previous one up to its lane (per thread) is kept, and an
+ * original name that starts with it, and still has tile, x and y after it,
+ * takes the previous read-group without parsing.
+ *
+ * The read-group is left empty if the read name does not match the format.
+ */
+void infer_read_group_sra(const char* inner_format, const std::string& qname, std::string& rg) {
+    static thread_local std::string inner, prefix, last;
+    static thread_local const char* last_format = NULL;
+    static thread_local format_list inner_formats;
+
+    // skip accession
+    size_t start = qname.find_first_of(" \t");
+    if (start == std::string::npos) {
+        rg.clear();
+        return;
+    }
+    ++start;
+
+    size_t end = qname.find_first_of(" \t", start);
+    if (end == std::string::npos) end = qname.length();
+
+    if (!prefix.empty() && last_format == inner_format
+            && qname.compare(start, prefix.length(), prefix) == 0) {
+        // tile, x and y must still follow, as checked by the full parse
+        size_t pos = find_in_string(qname, ':', start + prefix.length() - 1, 2);
+        if (pos < end) {
+            rg.assign(last);
+            return;
+        }
+    }
+
+    inner.assign(qname, start, end - start);
+    const char* matched = inner_format;
+    if (strchr(inner_format, ',') != NULL) {
+        infer_read_group_list(inner_formats, inner_format, inner, rg);
+        matched = inner_formats.formats[inner_formats.last].c_str();
+    } else {
+        infer_read_group(inner_format, inner, rg);
+    }
+
+    // keep `{instrument}:{run}:{flowcell}:{lane}:`
+    prefix.clear();
+    if (!rg.empty() && strcmp(matched, "illumina-1.8") == 0) {
+        size_t pos = find_in_string(inner, ':', 0, 4);
+        if (pos != std::string::npos) {
+            prefix.assign(inner, 0, pos + 1);
+            last.assign(rg);
+            last_format = inner_format;
+        }
+    }
+}
+
+/**
+ * Count matches by format afresh, so that a pass that reads the input again
+ * does not count its reads twice.
+ */
+void reset_format_hits() {
+    format_list& x = formats_tried;
+    x.hits.assign(x.formats.size(), 0);
+}
+
+/**
+ * Print the number of reads matched by each format of the format list in use.
+ */
+void report_format_hits(std::ostream& f) {
+    const format_list& x = formats_tried;
+    if (x.spec == NULL) return;
+    f << "Info: reads matched by read name format:";
+    for (size_t i = 0; i < x.formats.size(); ++i) {
+        f << (i == 0 ? " " : ", ") << x.formats[i] << " (" << x.hits[i] << ")";
+    }
+    f << std::endl;
+}
+
+/**
+ * Infer read-group based on flowcell id and lane id.
+ *
+ * `sra` reads Illumina 1.8 or 1.0 names from the comment of SRA read names,
+ * and `sra:{format}` names in another format. A comma-separated list of formats
+ * is tried in turn (see `infer_read_group_list`).
+ */
+void infer_read_group(const char* format, const std::string& qname, std::string& rg) {
+    if (strchr(format, ',') != NULL) {
+        infer_read_group_list(format, qname, rg);
+    } else if (strcmp(format, "illumina-1.0") == 0) {
+        infer_read_group_illumina10(qname, rg);
+    } else if (strcmp(format, "illumina-1.8") == 0) {
+        infer_read_group_illumina18(qname, rg);
+    } else if (strcmp(format, "broad-1.0") == 0) {
+        infer_read_group_broad10(qname, rg);
+    } else if (strcmp(format, "mgi") == 0) {
+        infer_read_group_mgi(qname, rg);
+    } else if (strcmp(format, "ont") == 0) {
+        infer_read_group_ont(qname, rg);
+    } else if (strcmp(format, "pacbio") == 0) {
+        infer_read_group_pacbio(qname, rg);
+    } else if (strcmp(format, "sra") == 0) {
+        infer_read_group_sra(sra_formats, qname, rg);
+    } else if (strncmp(format, "sra:", 4) == 0) {
+        infer_read_group_sra(format + 4, qname, rg);
+    } else {
+        throw std::runtime_error("Unsupported read format");
+    }
+}
+
+/**
+ * Whether read-group inference finds the fields of read names of a format.
+ */
+bool has_qname_fields(const char* format) {
+    return strcmp(format, "illumina-1.0") == 0 || strcmp(format, "illumina-1.8") == 0
+        || strcmp(format, "broad-1.0") == 0 || strcmp(format, "mgi") == 0;
+}
+
+/**
+ * Whether read-group inference finds field `f` of read names of a format;
+ * `mgi` names give only the flowcell and lane.
+ *
+ * The index is not found by inference but read from the name itself, which
+ * keeps it only in FASTQ input.
+ */
+bool has_qname_field(const char* format, qname_fields::field f) {
+    if (!has_qname_fields(format)) return false;
+    if (strcmp(format, "mgi") == 0) {
+        return f == qname_fields::FLOWCELL || f == qname_fields::LANE;
+    }
+    return true;
+}
+
+/**
+ * Infer read-group, and if `fields` is given, the positions of the fields of
+ * the read name in the same scan.
+ *
+ * Fields are found for the formats of `has_qname_fields` only, and not the
+ * index; they are all missing if the read-group is not inferred.
+ */
+void infer_read_group(const char* format, const std::string& qname, std::string& rg, qname_fields::range* fields) {
+    if (fields == NULL) {
+        infer_read_group(format, qname, rg);
+        return;
+    }
+    qname_fields::clear(fields);
+    if (strcmp(format, "illumina-1.0") == 0) {
+        infer_read_group_illumina10(qname, rg, fields);
+    } else if (strcmp(format, "illumina-1.8") == 0) {
+        infer_read_group_illumina18(qname, rg, fields);
+    } else if (strcmp(format, "broad-1.0") == 0) {
+        infer_read_group_broad10(qname, rg, fields);
+    } else if (strcmp(format, "mgi") == 0) {
+        infer_read_group_mgi(qname, rg, fields);
+    } else {
+        infer_read_group(format, qname, rg);
+    }
+}
+
+#endif  // _RGSAM_QNAME_HPP_
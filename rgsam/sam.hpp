@@ -6,6 +6,7 @@
 #include <map>
 #include <list>
 #include <fstream>
+#include <cstring>
 
 #include "string.hpp"
 
@@ -28,13 +29,22 @@ struct opt_field {
     }
 
     opt_field(const string& x) {
-        if (x.length() > 5) {
-            tag[0] = x[0];
-            tag[1] = x[1];
-            if (x[2] == ':') {
-                type = x[3];
-                if (x[4] == ':') {
-                    value = x.substr(5);
+        assign(x, 0, x.length());
+    }
+
+    /**
+     * Parse the field from `len` characters of `x` at `pos`, reusing the
+     * storage of the value.
+     */
+    void assign(const string& x, size_t pos, size_t len) {
+        value.clear();
+        if (len > 5) {
+            tag[0] = x[pos];
+            tag[1] = x[pos + 1];
+            if (x[pos + 2] == ':') {
+                type = x[pos + 3];
+                if (x[pos + 4] == ':') {
+                    value.assign(x, pos + 5, len - 5);
                 }
             }
         }
@@ -85,28 +95,55 @@ struct entry {
 
 /**
  * SAM entry whose core fields are not parsed.
+ *
+ * An entry can be reused for reading many lines, in which case its strings
+ * and list nodes are reused as well.
  */
 struct raw_entry {
     // raw core fields
     string core;
     // optional fields
     list<opt_field> opts;
+    // list nodes that are kept for reuse
+    list<opt_field> spare;
 };
 
 const size_t n_core_fields = 11;
 const char delim = '\t';
 
 /**
- * Parse optional fields from a string.
+ * Parse optional fields from a string, starting at `pos`.
+ *
+ * The fields replace the content of `opts`, reusing its nodes; nodes left
+ * over are moved to `spare`, and nodes are taken from `spare` before new
+ * ones are allocated.
  */
-void parse_opts(const string& x, list<opt_field>& opts) {
-    size_t pos = 0;
+void parse_opts(const string& x, size_t pos, list<opt_field>& opts, list<opt_field>& spare) {
+    list<opt_field>::iterator it = opts.begin();
     while (true) {
         size_t end = x.find(delim, pos);
-        opts.push_back(opt_field(x.substr(pos, end - pos)));
+        size_t len = (end == string::npos ? x.length() : end) - pos;
+        if (it == opts.end()) {
+            if (spare.empty()) {
+                spare.push_back(opt_field("  ", ' ', string()));
+            }
+            opts.splice(opts.end(), spare, spare.begin());
+            it = --opts.end();
+        }
+        it->assign(x, pos, len);
+        ++it;
         if (end == string::npos) break;
         pos = end + 1;
     }
+    spare.splice(spare.end(), opts, it, opts.end());
+}
+
+/**
+ * Parse optional fields from a string, replacing the content of `opts`.
+ */
+void parse_opts(const string& x, list<opt_field>& opts) {
+    list<opt_field> spare;
+    parse_opts(x, 0, opts, spare);
 }
 
 /**
@@ -117,8 +154,12 @@ bool extract_raw_entry(const string& line, raw_entry& x) {
 
     // split entry into core string and parsed opts
     size_t pos = find_in_string(line, delim, 0, n_core_fields);
-    x.core = line.substr(0, pos);
-    parse_opts(line.substr(pos + 1), x.opts);
+    x.core.assign(line, 0, pos);
+    if (pos == string::npos) {
+        x.spare.splice(x.spare.end(), x.opts);
+    } else {
+        parse_opts(line, pos + 1, x.opts, x.spare);
+    }
     
     return true;
 }
@@ -138,6 +179,17 @@ bool write_raw_entry(ostream& f, const raw_entry& x) {
     return true;
 }
 
+/**
+ * Number of bytes that a raw SAM entry occupies in file.
+ */
+size_t entry_size(const raw_entry& x) {
+    size_t n = x.core.length() + 1;
+    for (list<opt_field>::const_iterator it = x.opts.begin(); it != x.opts.end(); ++it) {
+        n += it->value.length() + 6;
+    }
+    return n;
+}
+
 /**
  * Functor for matching a tag.
  */
@@ -163,6 +215,28 @@ void replace_opt_field(list<opt_field>& opts, const opt_field& x) {
     opts.push_back(x);
 }
 
+/**
+ * Replace an optional field of an entry, reusing list nodes.
+ *
+ * As with the list version, the field is moved to the end.
+ */
+void replace_opt_field(raw_entry& e, const opt_field& x) {
+    tag_match match(x.tag);
+    list<opt_field>::iterator it = e.opts.begin();
+    while (it != e.opts.end()) {
+        list<opt_field>::iterator next = it;
+        ++next;
+        if (match(*it)) e.spare.splice(e.spare.end(), e.opts, it);
+        it = next;
+    }
+    if (e.spare.empty()) {
+        e.opts.push_back(x);
+    } else {
+        e.opts.splice(e.opts.end(), e.spare, e.spare.begin());
+        e.opts.back() = x;
+    }
+}
+
 /**
  * Get the read name from the string of the SAM core fields.
  */
@@ -170,6 +244,77 @@ string get_qname_from_core(const string& core) {
     return core.substr(0, core.find(delim));
 }
 
+/**
+ * Get the read name from the string of the SAM core fields, reusing the
+ * storage of `qname`.
+ */
+void get_qname_from_core(const string& core, string& qname) {
+    qname.assign(core, 0, core.find(delim));
+}
+
+/**
+ * Find the value of the optional field with a two-character tag in a SAM
+ * entry line from `p` to `end`.
+ *
+ * The optional fields are not parsed: the line is scanned for the tag, after
+ * a tab past the core fields, so each field is skipped without being split.
+ * On success, `value` and `len` give the value, after its type.
+ */
+bool find_opt_value(const char* p, const char* end, const char* tag, const char*& value, size_t& len) {
+    // skip core fields
+    for (size_t i = 0; i < n_core_fields; ++i) {
+        p = static_cast<const char*>(memchr(p, delim, end - p));
+        if (p == NULL) return false;
+        ++p;
+    }
+
+    const char needle[4] = { delim, tag[0], tag[1], ':' };
+    --p;
+    while (p < end) {
+        const char* hit = static_cast<const char*>(memmem(p, end - p, needle, 4));
+        if (hit == NULL || end - hit < 6) return false;
+        if (hit[5] == ':') {
+            value = hit + 6;
+            const char* value_end = static_cast<const char*>(memchr(value, delim, end - value));
+            len = (value_end == NULL ? end : value_end) - value;
+            return true;
+        }
+        p = hit + 1;
+    }
+    return false;
+}
+
+/**
+ * Get the length of the read sequence from the string of the SAM core fields.
+ *
+ * An absent sequence (`*`) has length zero.
+ */
+size_t get_seq_length_from_core(const string& core) {
+    size_t start = find_in_string(core, delim, 0, 9);
+    if (start == string::npos) return 0;
+    ++start;
+    size_t end = core.find(delim, start);
+    if (end == string::npos) end = core.length();
+    if (end - start == 1 && core[start] == '*') return 0;
+    return end - start;
+}
+
+/**
+ * Get the read-group ID of a `@RG` header line.
+ */
+bool get_read_group_id(const string& line, string& id) {
+    if (line.find("@RG") != 0) return false;
+
+    size_t start = line.find("\tID:", 3);
+    if (start == string::npos) return false;
+    start += 4;
+    size_t end = line.find(delim, start);
+    if (end == string::npos) end = line.length();
+
+    id.assign(line, start, end - start);
+    return true;
+}
+
 /**
  * Read read groups from a SAM header file.
  *
@@ -181,15 +326,8 @@ bool read_read_groups(ifstream& f, map<string, string>& rgs) {
         getline(f, line);
         if (line.empty()) break;
 
-        if (line.find("@RG") != 0) break;
-
-        size_t start = line.find("ID:", 4);
-        if (start == string::npos) break;
-        size_t end = line.find(delim, start);
-        if (end == string::npos) break;
-
-        start += 3;
-        string id = line.substr(start, end - start);
+        string id;
+        if (!get_read_group_id(line, id)) break;
         rgs[id] = line;
     }
 
@@ -205,6 +343,32 @@ void write_read_groups(ostream& f, const map<string, string>& rgs) {
     }
 }
 
+/**
+ * Create a read-group header line (without trailing newline).
+ */
+string read_group_line(const string& rg, const char* sample, 
+        const char* library, const char* platform) {
+    string line = "@RG";
+    line += delim; line += "ID:"; line += rg;
+    line += delim; line += "PU:"; line += rg;
+    line += delim; line += "SM:"; line += sample;
+    line += delim; line += "LB:"; line += library;
+    line += delim; line += "PL:"; line += platform;
+    return line;
+}
+
+/**
+ * Create read-group header lines keyed by read-group ID.
+ *
+ * @param rgs  raw read-group value strings.
+ */
+void make_read_groups(const set<string>& rgs, const char* sample, 
+        const char* library, const char* platform, map<string, string>& out) {
+    for (set<string>::const_iterator it = rgs.begin(); it != rgs.end(); ++it) {
+        out[*it] = read_group_line(*it, sample, library, platform);
+    }
+}
+
 /**
  * Write read groups into a SAM header file.
  *
@@ -213,12 +377,7 @@ void write_read_groups(ostream& f, const map<string, string>& rgs) {
 void write_read_groups(ostream& f, const set<string> rgs, const char* sample, 
         const char* library, const char*platform) {
     for (set<string>::const_iterator it = rgs.begin(); it != rgs.end(); ++it) {
-        f   << "@RG" << delim
-            << "ID:" << *it << delim
-            << "PU:" << *it << delim
-            << "SM:" << sample << delim
-            << "LB:" << library << delim
-            << "PL:" << platform << endl;
+        f << read_group_line(*it, sample, library, platform) << endl;
     }
 }
 
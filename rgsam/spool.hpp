@@ -0,0 +1,91 @@
+#ifndef _RGSAM_SPOOL_HPP_
+#define _RGSAM_SPOOL_HPP_
+
+#include <string>
+#include <cstring>
+#include <cstdlib>
+#include <vector>
+#include <stdexcept>
+
+#include <unistd.h>
+#include <zlib.h>
+
+/**
+ * Compressed temporary file for holding lines between two passes.
+ *
+ * Lines are appended with `write`; after `rewind`, they are read back in the
+ * same order with `getline`. The file is unlinked as soon as it is created,
+ * so nothing is left behind if the process is interrupted.
+ */
+class spool {
+public:
+    spool() : fd(-1), f(NULL) {
+        const char* dir = std::getenv("TMPDIR");
+        if (dir == NULL || *dir == '\0') dir = "/tmp";
+        std::string tmpl = std::string(dir) + "/rgsam.XXXXXX";
+        std::vector<char> path(tmpl.begin(), tmpl.end());
+        path.push_back('\0');
+
+        fd = mkstemp(&path[0]);
+        if (fd < 0) throw std::runtime_error("could not create temporary file");
+        unlink(&path[0]);
+
+        // keep our own descriptor, since gzclose closes the one it is given
+        f = gzdopen(dup(fd), "wb1");
+        if (f == NULL) throw std::runtime_error("could not open temporary file");
+    }
+
+    ~spool() {
+        if (f != NULL) gzclose(f);
+        if (fd >= 0) close(fd);
+    }
+
+    /**
+     * Append one line.
+     */
+    void write(const std::string& line) {
+        if ((!line.empty() && gzwrite(f, line.data(), line.size()) == 0)
+                || gzputc(f, '\n') == -1) {
+            throw std::runtime_error("could not write to temporary file");
+        }
+    }
+
+    /**
+     * Finish writing and start reading from the first line.
+     */
+    void rewind() {
+        if (gzclose(f) != Z_OK) {
+            f = NULL;
+            throw std::runtime_error("could not write to temporary file");
+        }
+        lseek(fd, 0, SEEK_SET);
+        f = gzdopen(dup(fd), "rb");
+        if (f == NULL) throw std::runtime_error("could not read temporary file");
+    }
+
+    /**
+     * Read the next line.
+     */
+    bool getline(std::string& line) {
+        line.clear();
+        char buf[4096];
+        while (gzgets(f, buf, sizeof(buf)) != NULL) {
+            size_t n = std::strlen(buf);
+            if (n > 0 && buf[n - 1] == '\n') {
+                line.append(buf, n - 1);
+                return true;
+            }
+            line.append(buf, n);
+        }
+        return !line.empty();
+    }
+
+private:
+    int fd;
+    gzFile f;
+
+    spool(const spool&);
+    spool& operator=(const spool&);
+};
+
+#endif  // _RGSAM_SPOOL_HPP_
@@ -0,0 +1,91 @@
+#ifndef _RGSAM_SUMMARY_HPP_
+#define _RGSAM_SUMMARY_HPP_
+
+#include <string>
+#include <map>
+#include <vector>
+#include <fstream>
+
+#include "sam.hpp"
+
+namespace summary {
+
+using namespace std;
+
+/**
+ * Counts of reads and bases in one read-group.
+ */
+struct counts {
+    /// read lengths below this are counted in `short_lengths`
+    static const size_t max_short_length = 4096;
+
+    unsigned long long reads;
+    unsigned long long bases;
+    /// number of reads by read length, for short reads
+    vector<unsigned long long> short_lengths;
+    /// number of reads by read length, for long reads
+    map<size_t, unsigned long long> long_lengths;
+
+    counts() : reads(0), bases(0) {}
+
+    void add(size_t length) {
+        ++reads;
+        bases += length;
+        if (length < max_short_length) {
+            if (length >= short_lengths.size()) {
+                short_lengths.resize(length + 1);
+            }
+            ++short_lengths[length];
+        } else {
+            ++long_lengths[length];
+        }
+    }
+};
+
+typedef map<string, counts> rg_counts;
+
+/**
+ * Write a read-group summary as a SAM header.
+ *
+ * The `@RG` lines of the read-groups that were seen come first, so the
+ * summary can be used as a read-group header file. They are followed by
+ * one `@CO` line per read-group with the number of reads (NR), the number of
+ * bases (NB), and the read-length histogram (LH) as `<length>:<reads>` pairs.
+ *
+ * @param rgs  read-group header lines keyed by read-group ID
+ */
+void write(ostream& f, const rg_counts& x, const map<string, string>& rgs, const char* format) {
+    for (rg_counts::const_iterator it = x.begin(); it != x.end(); ++it) {
+        map<string, string>::const_iterator rg = rgs.find(it->first);
+        if (rg != rgs.end()) {
+            f << rg->second << endl;
+        }
+    }
+    f << "@CO" << sam::delim << "QF:" << format << endl;
+    for (rg_counts::const_iterator it = x.begin(); it != x.end(); ++it) {
+        f   << "@CO" << sam::delim
+            << "ID:" << it->first << sam::delim
+            << "NR:" << it->second.reads << sam::delim
+            << "NB:" << it->second.bases << sam::delim
+            << "LH:";
+        const vector<unsigned long long>& lengths = it->second.short_lengths;
+        bool first = true;
+        for (size_t i = 0; i < lengths.size(); ++i) {
+            if (lengths[i] == 0) continue;
+            if (!first) f << ',';
+            f << i << ':' << lengths[i];
+            first = false;
+        }
+        const map<size_t, unsigned long long>& long_lengths = it->second.long_lengths;
+        for (map<size_t, unsigned long long>::const_iterator l = long_lengths.begin(); l != long_lengths.end(); ++l) {
+            if (!first) f << ',';
+            f << l->first << ':' << l->second;
+            first = false;
+        }
+        f << endl;
+    }
+}
+
+}  // namespace summary
+
+#endif  // _RGSAM_SUMMARY_HPP_
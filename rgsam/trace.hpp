@@ -0,0 +1,122 @@
+#ifndef _RGSAM_TRACE_HPP_
+#define _RGSAM_TRACE_HPP_
+
+#include <iostream>
+#include <vector>
+#include <mutex>
+#include <cstdio>
+
+/**
+ * Stage tracing in the Chrome trace event format, viewable in Perfetto or
+ * chrome://tracing.
+ *
+ * Tracing every record would cost more than processing it, so records are
+ * traced in batches: each batch is one event, with one child event per stage
+ * holding the time spent in that stage over the batch. Stages interleave
+ * within a batch, so their events are laid end to end in stage order rather
+ * than at the times they actually ran.
+ *
+ * Events are appended to a buffer owned by the recording thread; locks are
+ * only taken when a thread registers its buffer and when the trace is
+ * written.
+ */
+
+namespace trace {
+
+/// whether events are recorded
+bool enabled = false;
+
+/// number of records per batch
+const unsigned long batch_size = 4096;
+
+/**
+ * Complete event, with times in ticks.
+ */
+struct event {
+    const char* name;
+    unsigned long long begin;
+    unsigned long long duration;
+    /// records in the batch, or 0 for a stage event
+    unsigned long records;
+};
+
+/**
+ * Events of one thread.
+ */
+struct buffer {
+    int tid;
+    std::vector<event> events;
+
+    buffer(int tid) : tid(tid) {}
+
+    void add(const char* name, unsigned long long begin, unsigned long long duration, unsigned long records) {
+        event e = { name, begin, duration, records };
+        events.push_back(e);
+    }
+};
+
+/**
+ * Buffers of all threads.
+ */
+struct registry {
+    std::mutex lock;
+    std::vector<buffer*> threads;
+
+    ~registry() {
+        for (size_t i = 0; i < threads.size(); ++i) delete threads[i];
+    }
+
+    buffer* add() {
+        std::lock_guard<std::mutex> guard(lock);
+        threads.push_back(new buffer(threads.size() + 1));
+        return threads.back();
+    }
+};
+
+registry all;
+
+/**
+ * Buffer of the calling thread.
+ */
+inline buffer& local() {
+    static thread_local buffer* x = all.add();
+    return *x;
+}
+
+/**
+ * Write all events as a JSON trace.
+ *
+ * Ticks are converted to microseconds since `start_ticks`.
+ */
+void write(std::ostream& f, unsigned long long start_ticks, double seconds_per_tick) {
+    std::lock_guard<std::mutex> guard(all.lock);
+    double us_per_tick = seconds_per_tick * 1e6;
+    char buf[256];
+    bool first = true;
+    f << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    for (size_t i = 0; i < all.threads.size(); ++i) {
+        const buffer& b = *all.threads[i];
+        snprintf(buf, sizeof(buf),
+                "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"thread %d\"}}",
+                b.tid, b.tid);
+        f << (first ? "\n" : ",\n") << buf;
+        first = false;
+        for (std::vector<event>::const_iterator it = b.events.begin(); it != b.events.end(); ++it) {
+            double ts = it->begin >= start_ticks ? (it->begin - start_ticks) * us_per_tick : 0.0;
+            int n = snprintf(buf, sizeof(buf),
+                    "{\"name\":\"%s\",\"cat\":\"rgsam\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f",
+                    it->name, b.tid, ts, it->duration * us_per_tick);
+            if (it->records > 0 && n < (int) sizeof(buf)) {
+                snprintf(buf + n, sizeof(buf) - n, ",\"args\":{\"records\":%lu}}", it->records);
+            } else if (n < (int) sizeof(buf)) {
+                snprintf(buf + n, sizeof(buf) - n, "}");
+            }
+            f << ",\n" << buf;
+        }
+    }
+    f << "\n]}" << std::endl;
+}
+
+}  // namespace trace
+
+#endif  // _RGSAM_TRACE_HPP_